@@ -8,232 +8,410 @@
 #include "Rook.h"
 #include "Queen.h"
 #include "King.h"
+#include "Zobrist.h"
 #include <vector>
-#include <memory>
 #include <ostream>
 #include <algorithm>
-#include <iostream>
+#include <bit>
+#include <cctype>
+#include <cstdint>
 
-Board::Board() : grid(8, std::vector<std::shared_ptr<Piece>>(8, nullptr)), currentTurn{Colour::White} {
+Board::Board() : state{}, statusKey{0}, status{GameStatus::Ongoing}, hasStatus{false} {
+  invalidateAttacks();
+  state.currentTurn = Colour::White;
+  state.lastPawnDoubleMove = {-1, -1};
   for (int file = 0; file < 8; ++file) {
-    grid[1][file] = std::make_shared<Pawn>(Colour::White);
-    grid[6][file] = std::make_shared<Pawn>(Colour::Black);
-  }
-  
-  grid[0][0] = std::make_shared<Rook>(Colour::White);
-  grid[0][1] = std::make_shared<Knight>(Colour::White);
-  grid[0][2] = std::make_shared<Bishop>(Colour::White);
-  grid[0][3] = std::make_shared<Queen>(Colour::White);
-  grid[0][4] = std::make_shared<King>(Colour::White);
-  grid[0][5] = std::make_shared<Bishop>(Colour::White);
-  grid[0][6] = std::make_shared<Knight>(Colour::White);
-  grid[0][7] = std::make_shared<Rook>(Colour::White);
-  
-  grid[7][0] = std::make_shared<Rook>(Colour::Black);
-  grid[7][1] = std::make_shared<Knight>(Colour::Black);
-  grid[7][2] = std::make_shared<Bishop>(Colour::Black);
-  grid[7][3] = std::make_shared<Queen>(Colour::Black);
-  grid[7][4] = std::make_shared<King>(Colour::Black);
-  grid[7][5] = std::make_shared<Bishop>(Colour::Black);
-  grid[7][6] = std::make_shared<Knight>(Colour::Black);
-  grid[7][7] = std::make_shared<Rook>(Colour::Black);
+    setSquare({file, 1}, Piece::get('P'));
+    setSquare({file, 6}, Piece::get('p'));
+  }
+  
+  setSquare({0, 0}, Piece::get('R'));
+  setSquare({1, 0}, Piece::get('N'));
+  setSquare({2, 0}, Piece::get('B'));
+  setSquare({3, 0}, Piece::get('Q'));
+  setSquare({4, 0}, Piece::get('K'));
+  setSquare({5, 0}, Piece::get('B'));
+  setSquare({6, 0}, Piece::get('N'));
+  setSquare({7, 0}, Piece::get('R'));
+  
+  setSquare({0, 7}, Piece::get('r'));
+  setSquare({1, 7}, Piece::get('n'));
+  setSquare({2, 7}, Piece::get('b'));
+  setSquare({3, 7}, Piece::get('q'));
+  setSquare({4, 7}, Piece::get('k'));
+  setSquare({5, 7}, Piece::get('b'));
+  setSquare({6, 7}, Piece::get('n'));
+  setSquare({7, 7}, Piece::get('r'));
+  
+  refreshStateKey();
 }
 
-Board::~Board() {
+// The status is checked against the hash before use, so copies may keep it
+Board::Board(const Board& other)
+  : state{other.state}, statusKey{other.statusKey}, status{other.status}, hasStatus{other.hasStatus} {
+  invalidateAttacks();
 }
 
-bool Board::isValidPos(Pos p) const {
-  return p.file >= 0 && p.file < 8 && p.rank >= 0 && p.rank < 8;
+Board& Board::operator=(const Board& other) {
+  state = other.state;
+  statusKey = other.statusKey;
+  status = other.status;
+  hasStatus = other.hasStatus;
+  invalidateAttacks();
+  return *this;
 }
 
-std::shared_ptr<Piece> Board::pieceAt(Pos p) const {
-  if (!isValidPos(p)) return nullptr;
-  return grid[p.rank][p.file];
-}
+namespace {
+  // Symbol of the given piece type (upper case letter) for side Us
+  template <Colour Us>
+  constexpr char symbolFor(char type) {
+    return Us == Colour::White ? type : static_cast<char>(type - 'A' + 'a');
+  }
 
-bool Board::simulateMove(Pos src, Pos dst, Colour playerColour) const {
-  auto tempGrid = grid;
-  
-  auto piece = pieceAt(src);
-  if (!piece) return false;
-  
-  tempGrid[dst.rank][dst.file] = piece;
-  tempGrid[src.rank][src.file] = nullptr;
+  // The set in state.pieces that a piece symbol belongs to
+  uint64_t& pieceSet(BoardState& state, char symbol) {
+    int side = (symbol >= 'a') ? 1 : 0;
+    PieceType type = PieceType::King;
+    switch (toupper(symbol)) {
+      case 'P': type = PieceType::Pawn; break;
+      case 'N': type = PieceType::Knight; break;
+      case 'B': type = PieceType::Bishop; break;
+      case 'R': type = PieceType::Rook; break;
+      case 'Q': type = PieceType::Queen; break;
+      default: break;
+    }
+    return state.pieces[side][static_cast<int>(type)];
+  }
 
-  if (piece->symbol() == 'P' || piece->symbol() == 'p') {
-    if (abs(dst.file - src.file) == 1 && abs(dst.rank - src.rank) == 1) {
-      if (!pieceAt(dst)) {
-        tempGrid[src.rank][dst.file] = nullptr;
+  constexpr int knightOffsets[8][2] = {
+    {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}
+  };
+
+  // Rook directions first, then bishop directions
+  constexpr int rayDirections[8][2] = {
+    {1, 0}, {0, -1}, {-1, 0}, {0, 1}, {1, 1}, {1, -1}, {-1, -1}, {-1, 1}
+  };
+
+  char symbolAt(const std::array<char, 64>& squares, int file, int rank) {
+    if (file < 0 || file > 7 || rank < 0 || rank > 7) return '\0';
+    return squares[rank * 8 + file];
+  }
+
+  // Does side By attack square? Works outwards from the square, so whatever
+  // stands on the square itself never counts as attacking it.
+  template <Colour By>
+  bool attackedBy(const std::array<char, 64>& squares, Pos square) {
+    constexpr char pawn = symbolFor<By>('P');
+    constexpr char knight = symbolFor<By>('N');
+    constexpr char bishop = symbolFor<By>('B');
+    constexpr char rook = symbolFor<By>('R');
+    constexpr char queen = symbolFor<By>('Q');
+    constexpr char king = symbolFor<By>('K');
+    // By's pawns capture towards this rank, so attackers stand one rank behind
+    constexpr int pawnDirection = (By == Colour::White) ? 1 : -1;
+
+    if (square.file < 0 || square.file > 7 || square.rank < 0 || square.rank > 7) return false;
+
+    int pawnRank = square.rank - pawnDirection;
+    if (symbolAt(squares, square.file - 1, pawnRank) == pawn ||
+        symbolAt(squares, square.file + 1, pawnRank) == pawn) {
+      return true;
+    }
+
+    for (const auto& offset : knightOffsets) {
+      if (symbolAt(squares, square.file + offset[0], square.rank + offset[1]) == knight) return true;
+    }
+
+    for (const auto& direction : rayDirections) {
+      if (symbolAt(squares, square.file + direction[0], square.rank + direction[1]) == king) return true;
+    }
+
+    for (int d = 0; d < 8; ++d) {
+      char slider = (d < 4) ? rook : bishop;
+      int file = square.file + rayDirections[d][0];
+      int rank = square.rank + rayDirections[d][1];
+      while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+        char symbol = squares[rank * 8 + file];
+        if (symbol) {
+          if (symbol == slider || symbol == queen) return true;
+          break;
+        }
+        file += rayDirections[d][0];
+        rank += rayDirections[d][1];
       }
     }
+
+    return false;
   }
-  
-  Pos kingPos{-1, -1};
-  for (int rank = 0; rank < 8; ++rank) {
-    for (int file = 0; file < 8; ++file) {
-      auto p = tempGrid[rank][file];
-      if (p && p->colour() == playerColour && 
-          (p->symbol() == 'K' || p->symbol() == 'k')) {
-        kingPos = {file, rank};
-        break;
+
+  // Squares a knight, king or pawn attacks from each square (bit rank * 8 + file)
+  struct StepAttacks {
+    uint64_t knight[64];
+    uint64_t king[64];
+    uint64_t pawn[2][64];  // White's pawns, then Black's
+  };
+
+  constexpr StepAttacks makeStepAttacks() {
+    StepAttacks tables{};
+    auto bit = [](int file, int rank) -> uint64_t {
+      if (file < 0 || file > 7 || rank < 0 || rank > 7) return 0;
+      return uint64_t{1} << (rank * 8 + file);
+    };
+    for (int index = 0; index < 64; ++index) {
+      int file = index % 8;
+      int rank = index / 8;
+      for (const auto& offset : knightOffsets) {
+        tables.knight[index] |= bit(file + offset[0], rank + offset[1]);
+      }
+      for (const auto& direction : rayDirections) {
+        tables.king[index] |= bit(file + direction[0], rank + direction[1]);
       }
+      tables.pawn[0][index] = bit(file - 1, rank + 1) | bit(file + 1, rank + 1);
+      tables.pawn[1][index] = bit(file - 1, rank - 1) | bit(file + 1, rank - 1);
     }
-    if (kingPos.file != -1) break;
+    return tables;
   }
-  
-  if (kingPos.file == -1) {
-    return false;
+
+  constexpr StepAttacks stepAttacks = makeStepAttacks();
+
+  // Squares attacked by By's piece on index. Sliders stop at the first piece
+  // in the way, whoever owns it.
+  template <Colour By>
+  uint64_t pieceAttacks(const std::array<char, 64>& squares, int index) {
+    constexpr char pawn = symbolFor<By>('P');
+    constexpr char knight = symbolFor<By>('N');
+    constexpr char bishop = symbolFor<By>('B');
+    constexpr char rook = symbolFor<By>('R');
+    constexpr char king = symbolFor<By>('K');
+    constexpr int side = (By == Colour::White) ? 0 : 1;
+
+    char symbol = squares[index];
+    if (symbol == pawn) return stepAttacks.pawn[side][index];
+    if (symbol == knight) return stepAttacks.knight[index];
+    if (symbol == king) return stepAttacks.king[index];
+
+    // Queen, rook or bishop: rook directions come first in rayDirections
+    uint64_t attacks = 0;
+    int first = (symbol == bishop) ? 4 : 0;
+    int last = (symbol == rook) ? 4 : 8;
+    for (int d = first; d < last; ++d) {
+      int file = index % 8 + rayDirections[d][0];
+      int rank = index / 8 + rayDirections[d][1];
+      while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+        attacks |= uint64_t{1} << (rank * 8 + file);
+        if (squares[rank * 8 + file]) break;
+        file += rayDirections[d][0];
+        rank += rayDirections[d][1];
+      }
+    }
+    return attacks;
   }
-  
-  for (int rank = 0; rank < 8; ++rank) {
-    for (int file = 0; file < 8; ++file) {
-      auto p = tempGrid[rank][file];
-      if (p && p->colour() != playerColour) {
-        bool canAttack = false;
-        
-        if (p->symbol() == 'P' || p->symbol() == 'p') {
-          int direction = (p->colour() == Colour::White) ? 1 : -1;
-          if ((rank + direction == kingPos.rank) && 
-              (abs(file - kingPos.file) == 1)) {
-            canAttack = true;
-          }
-        } else if (p->symbol() == 'N' || p->symbol() == 'n') {
-          int dx = abs(file - kingPos.file);
-          int dy = abs(rank - kingPos.rank);
-          if ((dx == 1 && dy == 2) || (dx == 2 && dy == 1)) {
-            canAttack = true;
-          }
-        } else if (p->symbol() == 'B' || p->symbol() == 'b' || 
-                   p->symbol() == 'Q' || p->symbol() == 'q') {
-          if (abs(file - kingPos.file) == abs(rank - kingPos.rank)) {
-            int dx = (kingPos.file > file) ? 1 : -1;
-            int dy = (kingPos.rank > rank) ? 1 : -1;
-            bool pathClear = true;
-            
-            int x = file + dx;
-            int y = rank + dy;
-            while (x != kingPos.file && y != kingPos.rank) {
-              if (tempGrid[y][x]) {
-                pathClear = false;
-                break;
-              }
-              x += dx;
-              y += dy;
-            }
-            if (pathClear) canAttack = true;
-          }
-        }
-        
-        if (p->symbol() == 'R' || p->symbol() == 'r' || 
-            p->symbol() == 'Q' || p->symbol() == 'q') {
-          if (file == kingPos.file || rank == kingPos.rank) {
-            bool pathClear = true;
-            if (file == kingPos.file) {
-              int step = (kingPos.rank > rank) ? 1 : -1;
-              for (int y = rank + step; y != kingPos.rank; y += step) {
-                if (tempGrid[y][file]) {
-                  pathClear = false;
-                  break;
-                }
-              }
-            } else {
-              int step = (kingPos.file > file) ? 1 : -1;
-              for (int x = file + step; x != kingPos.file; x += step) {
-                if (tempGrid[rank][x]) {
-                  pathClear = false;
-                  break;
-                }
-              }
-            }
-            if (pathClear) canAttack = true;
-          }
-        }
-        
-        if (p->symbol() == 'K' || p->symbol() == 'k') {
-          if (abs(file - kingPos.file) <= 1 && abs(rank - kingPos.rank) <= 1) {
-            canAttack = true;
-          }
-        }
-        
-        if (canAttack) {
-          return false;
-        }
+
+  template <Colour By>
+  uint64_t attacksOf(const BoardState& state) {
+    const auto& sets = state.pieces[By == Colour::White ? 0 : 1];
+    uint64_t attacks = 0;
+    for (uint64_t own = sets[0] | sets[1] | sets[2] | sets[3] | sets[4] | sets[5]; own; own &= own - 1) {
+      attacks |= pieceAttacks<By>(state.squares, std::countr_zero(own));
+    }
+    return attacks;
+  }
+
+  template <Colour By>
+  void countAttackers(const BoardState& state, std::array<uint8_t, 64>& attackers) {
+    const auto& sets = state.pieces[By == Colour::White ? 0 : 1];
+    attackers.fill(0);
+    for (uint64_t own = sets[0] | sets[1] | sets[2] | sets[3] | sets[4] | sets[5]; own; own &= own - 1) {
+      for (uint64_t attacks = pieceAttacks<By>(state.squares, std::countr_zero(own)); attacks;
+           attacks &= attacks - 1) {
+        ++attackers[std::countr_zero(attacks)];
       }
     }
   }
-  
-  return true;
+
+  // Is Us's king, standing on king, safe after moving src to dst (en passant included)?
+  template <Colour Us>
+  bool leavesKingSafe(std::array<char, 64> squares, Pos src, Pos dst, Pos king) {
+    constexpr Colour them = (Us == Colour::White) ? Colour::Black : Colour::White;
+    constexpr char pawn = symbolFor<Us>('P');
+
+    char moving = squares[src.rank * 8 + src.file];
+    if (!moving) return false;
+    if (king.file < 0) return false;
+
+    // A pawn moving diagonally onto an empty square captures en passant
+    if (moving == pawn && dst.file != src.file && !squares[dst.rank * 8 + dst.file]) {
+      squares[src.rank * 8 + dst.file] = '\0';
+    }
+    squares[dst.rank * 8 + dst.file] = moving;
+    squares[src.rank * 8 + src.file] = '\0';
+
+    if (king.file == src.file && king.rank == src.rank) king = dst;
+    return !attackedBy<them>(squares, king);
+  }
 }
 
-bool Board::isCheckmate(Colour c) const {
-  if (!isInCheck(c)) {
-    return false;
+bool Board::isValidPos(Pos p) const {
+  return p.file >= 0 && p.file < 8 && p.rank >= 0 && p.rank < 8;
+}
+
+const Piece* Board::pieceAt(Pos p) const {
+  if (!isValidPos(p)) return nullptr;
+  return Piece::get(state.squares[p.rank * 8 + p.file]);
+}
+
+// Checking a move only needs the mailbox: copy it, make the move on the
+// copy and see whether the mover's king is attacked
+bool Board::simulateMove(Pos src, Pos dst, Colour playerColour) const {
+  if (playerColour == Colour::White) {
+    return leavesKingSafe<Colour::White>(state.squares, src, dst, kingSquare(Colour::White));
   }
-  
-  for (int srcRank = 0; srcRank < 8; ++srcRank) {
-    for (int srcFile = 0; srcFile < 8; ++srcFile) {
-      Pos src{srcFile, srcRank};
-      auto piece = pieceAt(src);
-      
-      if (!piece || piece->colour() != c) {
-        continue;
+  return leavesKingSafe<Colour::Black>(state.squares, src, dst, kingSquare(Colour::Black));
+}
+
+// Side and move kind are template parameters, so the ownership, promotion
+// rank and capture tests below are resolved at compile time
+template <Colour Us, MoveGenType Type>
+void Board::generateLegalMoves(std::vector<Move>& moves) const {
+  constexpr char pawn = symbolFor<Us>('P');
+  constexpr int promotionRank = (Us == Colour::White) ? 7 : 0;
+  Pos king = kingSquare(Us);
+  
+  // Lowest bit first is board order
+  for (uint64_t own = occupied(Us); own; own &= own - 1) {
+    int index = std::countr_zero(own);
+    char symbol = state.squares[index];
+    Pos src{index % 8, index / 8};
+    
+    for (const auto& dst : Piece::get(symbol)->legalMoves(*this, src)) {
+      if constexpr (Type != MoveGenType::All) {
+        bool capture = state.squares[dst.rank * 8 + dst.file] != '\0' ||
+                       (symbol == pawn && dst.file != src.file);
+        if (capture != (Type == MoveGenType::Captures)) continue;
       }
       
-      auto legalMoves = piece->legalMoves(*this, src);
+      if (!leavesKingSafe<Us>(state.squares, src, dst, king)) continue;
       
-      for (const auto& dst : legalMoves) {
-        if (simulateMove(src, dst, c)) {
-          return false;
-        }
+      if (symbol == pawn && dst.rank == promotionRank) {
+        moves.push_back(Move(src, dst, 'Q'));
+        moves.push_back(Move(src, dst, 'R'));
+        moves.push_back(Move(src, dst, 'B'));
+        moves.push_back(Move(src, dst, 'N'));
+      } else {
+        moves.push_back(Move(src, dst));
       }
     }
   }
-  
-  return true;
+}
+
+void Board::legalMoves(Colour c, MoveGenType type, std::vector<Move>& moves) const {
+  if (c == Colour::White) {
+    switch (type) {
+      case MoveGenType::Captures: generateLegalMoves<Colour::White, MoveGenType::Captures>(moves); break;
+      case MoveGenType::Quiets: generateLegalMoves<Colour::White, MoveGenType::Quiets>(moves); break;
+      case MoveGenType::All: generateLegalMoves<Colour::White, MoveGenType::All>(moves); break;
+    }
+  } else {
+    switch (type) {
+      case MoveGenType::Captures: generateLegalMoves<Colour::Black, MoveGenType::Captures>(moves); break;
+      case MoveGenType::Quiets: generateLegalMoves<Colour::Black, MoveGenType::Quiets>(moves); break;
+      case MoveGenType::All: generateLegalMoves<Colour::Black, MoveGenType::All>(moves); break;
+    }
+  }
+}
+
+bool Board::isCheckmate(Colour c) const {
+  return isInCheck(c) && !hasLegalMove(c);
 }
 
 bool Board::isStalemate(Colour c) const {
-  if (isInCheck(c)) {
-    return false;
+  return !isInCheck(c) && !hasLegalMove(c);
+}
+
+// King moves first: there are few of them and in check they are the usual
+// way out. Out of check nearly every move is legal, so the other pieces are
+// tried one at a time, each piece's captures before its quiet moves.
+bool Board::hasLegalMove(Colour c) const {
+  Pos king = kingSquare(c);
+  if (isValidPos(king)) {
+    for (const auto& dst : pieceAt(king)->legalMoves(*this, king)) {
+      if (simulateMove(king, dst, c)) return true;
+    }
   }
   
-  for (int srcRank = 0; srcRank < 8; ++srcRank) {
-    for (int srcFile = 0; srcFile < 8; ++srcFile) {
-      Pos src{srcFile, srcRank};
-      auto piece = pieceAt(src);
-      
-      if (!piece || piece->colour() != c) {
-        continue;
-      }
-      
-      auto legalMoves = piece->legalMoves(*this, src);
-      
-      for (const auto& dst : legalMoves) {
-        if (simulateMove(src, dst, c)) {
-          return false;
-        }
+  Colour them = (c == Colour::White) ? Colour::Black : Colour::White;
+  uint64_t enemies = occupied(them);
+  for (uint64_t own = occupied(c) & ~pieces(c, PieceType::King); own; own &= own - 1) {
+    int index = std::countr_zero(own);
+    Pos src{index % 8, index / 8};
+    auto piece = pieceAt(src);
+    bool isPawn = (piece->symbol() == 'P' || piece->symbol() == 'p');
+    auto targets = piece->legalMoves(*this, src);
+    
+    for (bool captures : {true, false}) {
+      for (const auto& dst : targets) {
+        bool capture = ((enemies >> (dst.rank * 8 + dst.file)) & 1) || (isPawn && dst.file != src.file);
+        if (capture == captures && simulateMove(src, dst, c)) return true;
       }
     }
   }
+  return false;
+}
+
+GameStatus Board::gameStatus() const {
+  if (hasStatus && statusKey == state.zobristKey) return status;
+  
+  Colour c = state.currentTurn;
+  bool check = isInCheck(c);
+  if (!hasLegalMove(c)) {
+    status = check ? GameStatus::Checkmate : GameStatus::Stalemate;
+  } else if (isInsufficientMaterial()) {
+    status = GameStatus::DrawByRule;
+  } else {
+    status = check ? GameStatus::Check : GameStatus::Ongoing;
+  }
   
-  return true;
+  statusKey = state.zobristKey;
+  hasStatus = true;
+  return status;
 }
 
-std::shared_ptr<Piece> Board::createPromotedPiece(char pieceType, Colour c) {
+// Read off the piece sets, so it costs a few masks and a popcount
+bool Board::isInsufficientMaterial() const {
+  uint64_t heavy = 0;
+  uint64_t knights = 0;
+  uint64_t bishops = 0;
+  for (Colour c : {Colour::White, Colour::Black}) {
+    heavy |= pieces(c, PieceType::Pawn) | pieces(c, PieceType::Rook) | pieces(c, PieceType::Queen);
+    knights |= pieces(c, PieceType::Knight);
+    bishops |= pieces(c, PieceType::Bishop);
+  }
+  if (heavy) return false;
+  if (std::popcount(knights | bishops) <= 1) return true;
+  if (knights) return false;
+  
+  // Bishops confined to one colour of square can never attack a king
+  // standing on the other colour, so no mate is possible
+  constexpr uint64_t darkSquares = 0xAA55AA55AA55AA55ULL;  // a1, c1, ..., b2, ...
+  return !(bishops & darkSquares) || !(bishops & ~darkSquares);
+}
+
+const Piece* Board::createPromotedPiece(char pieceType, Colour c) {
+  char symbol = 'Q';
   switch (toupper(pieceType)) {
-    case 'Q': return std::make_shared<Queen>(c);
-    case 'R': return std::make_shared<Rook>(c);
-    case 'B': return std::make_shared<Bishop>(c);
-    case 'N': return std::make_shared<Knight>(c);
-    default: return std::make_shared<Queen>(c);
+    case 'R': symbol = 'R'; break;
+    case 'B': symbol = 'B'; break;
+    case 'N': symbol = 'N'; break;
+    default: break;
   }
+  return Piece::get(c == Colour::White ? symbol : tolower(symbol));
 }
 
 bool Board::move(Pos src, Pos dst, char promotionPiece) {
   auto piece = pieceAt(src);
   if (!piece) return false;
   
-  if (piece->colour() != currentTurn) return false;
+  if (piece->colour() != state.currentTurn) return false;
   
   bool isCastling = canCastle(src, dst);
   bool isEnPassant = isEnPassantCapture(src, dst);
@@ -248,7 +426,7 @@ bool Board::move(Pos src, Pos dst, char promotionPiece) {
     }
   }
   
-  if (!simulateMove(src, dst, currentTurn)) {
+  if (!simulateMove(src, dst, state.currentTurn)) {
     return false;
   }
   
@@ -258,7 +436,7 @@ bool Board::move(Pos src, Pos dst, char promotionPiece) {
     performEnPassant(src, dst);
   } else {
     bool isPawnPromotion = false;
-    if (dynamic_cast<Pawn*>(piece.get())) {
+    if (dynamic_cast<const Pawn*>(piece)) {
       if ((piece->colour() == Colour::White && dst.rank == 7) ||
           (piece->colour() == Colour::Black && dst.rank == 0)) {
         isPawnPromotion = true;
@@ -266,16 +444,17 @@ bool Board::move(Pos src, Pos dst, char promotionPiece) {
     }
     
     if (isPawnPromotion) {
-      grid[dst.rank][dst.file] = createPromotedPiece(promotionPiece, piece->colour());
+      setSquare(dst, createPromotedPiece(promotionPiece, piece->colour()));
     } else {
-      grid[dst.rank][dst.file] = piece;
+      setSquare(dst, piece);
     }
-    grid[src.rank][src.file] = nullptr;
+    setSquare(src, nullptr);
   }
   
   updateSpecialMoveTracking(src, dst, piece);
   
-  currentTurn = (currentTurn == Colour::White) ? Colour::Black : Colour::White;
+  state.currentTurn = (state.currentTurn == Colour::White) ? Colour::Black : Colour::White;
+  refreshStateKey();
   
   return true;
 }
@@ -284,28 +463,51 @@ bool Board::move(Pos src, Pos dst) {
   return move(src, dst, 'Q');
 }
 
-bool Board::isInCheck(Colour c) const {
-  Pos kingPos{-1, -1};
-  for (int rank = 0; rank < 8; ++rank) {
-    for (int file = 0; file < 8; ++file) {
-      auto piece = grid[rank][file];
-      if (piece && piece->colour() == c && 
-          (piece->symbol() == 'K' || piece->symbol() == 'k')) {
-        kingPos = {file, rank};
-        break;
-      }
+// Generated moves are already legal, so the kind of move follows from the
+// piece and squares alone: a king moving two files castles, a pawn moving
+// diagonally onto an empty square captures en passant
+void Board::makeMove(const Move& move) {
+  Pos src = move.from;
+  Pos dst = move.to;
+  auto piece = pieceAt(src);
+  char symbol = piece->symbol();
+  bool isPawn = (symbol == 'P' || symbol == 'p');
+  
+  if ((symbol == 'K' || symbol == 'k') && abs(dst.file - src.file) == 2) {
+    performCastling(src, dst);
+  } else if (isPawn && dst.file != src.file && !pieceAt(dst)) {
+    performEnPassant(src, dst);
+  } else {
+    if (isPawn && (dst.rank == 7 || dst.rank == 0)) {
+      setSquare(dst, createPromotedPiece(move.promotion, piece->colour()));
+    } else {
+      setSquare(dst, piece);
     }
-    if (kingPos.file != -1) break;
+    setSquare(src, nullptr);
   }
   
-  return isSquareAttacked(kingPos, c);
+  updateSpecialMoveTracking(src, dst, piece);
+  
+  state.currentTurn = (state.currentTurn == Colour::White) ? Colour::Black : Colour::White;
+  refreshStateKey();
+}
+
+bool Board::isInCheck(Colour c) const {
+  return isSquareAttacked(kingSquare(c), c);
+}
+
+Pos Board::kingSquare(Colour c) const {
+  uint64_t king = pieces(c, PieceType::King);
+  if (!king) return {-1, -1};
+  int index = std::countr_zero(king);
+  return {index % 8, index / 8};
 }
 
 void Board::draw(std::ostream& os) const {
   for (int rank = 7; rank >= 0; --rank) {
     os << rank + 1 << " ";
     for (int file = 0; file < 8; ++file) {
-      auto piece = grid[rank][file];
+      auto piece = pieceAt({file, rank});
       if (piece) {
         os << piece->symbol();
       } else {
@@ -330,9 +532,9 @@ bool Board::isCastlingMove(Pos src, Pos dst) const {
   
   bool isWhiteKing = (piece->colour() == Colour::White);
   if (isWhiteKing) {
-    if (src.file != 4 || src.rank != 0 || whiteKingMoved) return false;
+    if (src.file != 4 || src.rank != 0 || state.whiteKingMoved) return false;
   } else {
-    if (src.file != 4 || src.rank != 7 || blackKingMoved) return false;
+    if (src.file != 4 || src.rank != 7 || state.blackKingMoved) return false;
   }
   
   bool isKingSideCastling = (dst.file > src.file);
@@ -344,11 +546,11 @@ bool Board::isCastlingMove(Pos src, Pos dst) const {
   if (rook->colour() != piece->colour()) return false;
   
   if (isWhiteKing) {
-    if (isKingSideCastling && whiteRookHMoved) return false;
-    if (!isKingSideCastling && whiteRookAMoved) return false;
+    if (isKingSideCastling && state.whiteRookHMoved) return false;
+    if (!isKingSideCastling && state.whiteRookAMoved) return false;
   } else {
-    if (isKingSideCastling && blackRookHMoved) return false;
-    if (!isKingSideCastling && blackRookAMoved) return false;
+    if (isKingSideCastling && state.blackRookHMoved) return false;
+    if (!isKingSideCastling && state.blackRookAMoved) return false;
   }
   
   int step = isKingSideCastling ? 1 : -1;
@@ -358,13 +560,11 @@ bool Board::isCastlingMove(Pos src, Pos dst) const {
   
   if (isInCheck(piece->colour())) return false;
   
+  // The king is not in check, so lifting it cannot expose the squares it
+  // crosses: the attack map of this position answers for both
   for (int f = src.file + step; f != src.file + 3*step; f += step) {
     if (f < 0 || f > 7) break;
-    
-    Board tempBoard = *this;
-    tempBoard.grid[src.rank][src.file] = nullptr;
-    tempBoard.grid[src.rank][f] = piece;
-    if (tempBoard.isInCheck(piece->colour())) return false;
+    if (isSquareAttacked({f, src.rank}, piece->colour())) return false;
   }
   
   return true;
@@ -384,7 +584,7 @@ bool Board::isEnPassantCapture(Pos src, Pos dst) const {
   
   if (pieceAt(dst)) return false;
   
-  if (lastPawnDoubleMove.file == dst.file && lastPawnDoubleMove.rank == src.rank) {
+  if (state.lastPawnDoubleMove.file == dst.file && state.lastPawnDoubleMove.rank == src.rank) {
     return true;
   }
   
@@ -405,7 +605,7 @@ bool Board::canEnPassantCapture(Pos src, Pos dst) const {
   
   if (pieceAt(dst)) return false;
   
-  if (lastPawnDoubleMove.file == dst.file && lastPawnDoubleMove.rank == src.rank) {
+  if (state.lastPawnDoubleMove.file == dst.file && state.lastPawnDoubleMove.rank == src.rank) {
     return true;
   }
   
@@ -422,154 +622,120 @@ void Board::performCastling(Pos src, Pos dst) {
   
   int newRookFile = isKingSideCastling ? 5 : 3;
   
-  grid[dst.rank][dst.file] = king;
-  grid[src.rank][src.file] = nullptr;
+  setSquare(dst, king);
+  setSquare(src, nullptr);
   
-  grid[rookRank][newRookFile] = rook;
-  grid[rookRank][rookFile] = nullptr;
+  setSquare({newRookFile, rookRank}, rook);
+  setSquare({rookFile, rookRank}, nullptr);
   
   if (king->colour() == Colour::White) {
-    whiteKingMoved = true;
+    state.whiteKingMoved = true;
     if (isKingSideCastling) {
-      whiteRookHMoved = true;
+      state.whiteRookHMoved = true;
     } else {
-      whiteRookAMoved = true;
+      state.whiteRookAMoved = true;
     }
   } else {
-    blackKingMoved = true;
+    state.blackKingMoved = true;
     if (isKingSideCastling) {
-      blackRookHMoved = true;
+      state.blackRookHMoved = true;
     } else {
-      blackRookAMoved = true;
+      state.blackRookAMoved = true;
     }
   }
 }
 
 void Board::performEnPassant(Pos src, Pos dst) {
   auto pawn = pieceAt(src);
-  grid[dst.rank][dst.file] = pawn;
-  grid[src.rank][src.file] = nullptr;
-  grid[src.rank][dst.file] = nullptr;
+  setSquare(dst, pawn);
+  setSquare(src, nullptr);
+  setSquare({dst.file, src.rank}, nullptr);
 }
 
-void Board::updateSpecialMoveTracking(Pos src, Pos dst, std::shared_ptr<Piece> piece) {
+void Board::updateSpecialMoveTracking(Pos src, Pos dst, const Piece* piece) {
   if (piece->symbol() == 'K') {
-    whiteKingMoved = true;
+    state.whiteKingMoved = true;
   } else if (piece->symbol() == 'k') {
-    blackKingMoved = true;
+    state.blackKingMoved = true;
   } else if (piece->symbol() == 'R') {
     if (src.rank == 0) {
-      if (src.file == 0) whiteRookAMoved = true;
-      if (src.file == 7) whiteRookHMoved = true;
+      if (src.file == 0) state.whiteRookAMoved = true;
+      if (src.file == 7) state.whiteRookHMoved = true;
     }
   } else if (piece->symbol() == 'r') {
     if (src.rank == 7) {
-      if (src.file == 0) blackRookAMoved = true;
-      if (src.file == 7) blackRookHMoved = true;
+      if (src.file == 0) state.blackRookAMoved = true;
+      if (src.file == 7) state.blackRookHMoved = true;
     }
   }
   
   if (piece->symbol() == 'P' || piece->symbol() == 'p') {
     if (abs(dst.rank - src.rank) == 2) {
-      lastPawnDoubleMove = dst;
+      state.lastPawnDoubleMove = dst;
     } else {
-      lastPawnDoubleMove = {-1, -1};
+      state.lastPawnDoubleMove = {-1, -1};
     }
   } else {
-    lastPawnDoubleMove = {-1, -1};
+    state.lastPawnDoubleMove = {-1, -1};
   }
 } 
 
+// Most boards built during a search are asked about a square or two per side
+// (evaluation checks both kings twice) and then dropped, so the first
+// questions are answered by a direct scan and only the next one builds the map
 bool Board::isSquareAttacked(Pos square, Colour defendingColour) const {
-  for (int rank = 0; rank < 8; ++rank) {
-    for (int file = 0; file < 8; ++file) {
-      auto piece = grid[rank][file];
-      if (piece && piece->colour() != defendingColour) {
-        bool canAttack = false;
-        
-        if (piece->symbol() == 'P' || piece->symbol() == 'p') {
-          int direction = (piece->colour() == Colour::White) ? 1 : -1;
-          if ((rank + direction == square.rank) && 
-              (abs(file - square.file) == 1)) {
-            canAttack = true;
-          }
-        } else if (piece->symbol() == 'N' || piece->symbol() == 'n') {
-          int dx = abs(file - square.file);
-          int dy = abs(rank - square.rank);
-          if ((dx == 1 && dy == 2) || (dx == 2 && dy == 1)) {
-            canAttack = true;
-          }
-        } else if (piece->symbol() == 'B' || piece->symbol() == 'b' || 
-                   piece->symbol() == 'Q' || piece->symbol() == 'q') {
-          if (abs(file - square.file) == abs(rank - square.rank)) {
-            int dx = (square.file > file) ? 1 : -1;
-            int dy = (square.rank > rank) ? 1 : -1;
-            bool pathClear = true;
-            
-            int x = file + dx;
-            int y = rank + dy;
-            while (x != square.file && y != square.rank) {
-              if (pieceAt({x, y})) {
-                pathClear = false;
-                break;
-              }
-              x += dx;
-              y += dy;
-            }
-            if (pathClear) canAttack = true;
-          }
-        }
-        
-        if (piece->symbol() == 'R' || piece->symbol() == 'r' || 
-            piece->symbol() == 'Q' || piece->symbol() == 'q') {
-          if (file == square.file || rank == square.rank) {
-            bool pathClear = true;
-            if (file == square.file) {
-              int step = (square.rank > rank) ? 1 : -1;
-              for (int y = rank + step; y != square.rank; y += step) {
-                if (pieceAt({file, y})) {
-                  pathClear = false;
-                  break;
-                }
-              }
-            } else {
-              int step = (square.file > file) ? 1 : -1;
-              for (int x = file + step; x != square.file; x += step) {
-                if (pieceAt({x, rank})) {
-                  pathClear = false;
-                  break;
-                }
-              }
-            }
-            if (pathClear) canAttack = true;
-          }
-        }
-        
-        if (piece->symbol() == 'K' || piece->symbol() == 'k') {
-          if (abs(file - square.file) <= 1 && abs(rank - square.rank) <= 1) {
-            canAttack = true;
-          }
-        }
-        
-        if (canAttack) {
-          return true;
-        }
-      }
+  if (!isValidPos(square)) return false;
+  Colour by = (defendingColour == Colour::White) ? Colour::Black : Colour::White;
+  AttackMap& map = attackMaps[by == Colour::White ? 0 : 1];
+  if (!map.hasSquares && map.directQueries < 2) {
+    ++map.directQueries;
+    return (by == Colour::White) ? attackedBy<Colour::White>(state.squares, square)
+                                 : attackedBy<Colour::Black>(state.squares, square);
+  }
+  return (attackedSquares(by) >> (square.rank * 8 + square.file)) & 1;
+}
+
+uint64_t Board::attackedSquares(Colour by) const {
+  AttackMap& map = attackMaps[by == Colour::White ? 0 : 1];
+  if (!map.hasSquares) {
+    map.squares = (by == Colour::White) ? attacksOf<Colour::White>(state)
+                                        : attacksOf<Colour::Black>(state);
+    map.hasSquares = true;
+  }
+  return map.squares;
+}
+
+int Board::attackerCount(Pos square, Colour by) const {
+  if (!isValidPos(square)) return 0;
+  AttackMap& map = attackMaps[by == Colour::White ? 0 : 1];
+  if (!map.hasAttackers) {
+    if (by == Colour::White) {
+      countAttackers<Colour::White>(state, map.attackers);
+    } else {
+      countAttackers<Colour::Black>(state, map.attackers);
     }
+    map.hasAttackers = true;
+  }
+  return map.attackers[square.rank * 8 + square.file];
+}
+
+void Board::invalidateAttacks() {
+  for (auto& map : attackMaps) {
+    map.directQueries = 0;
+    map.hasSquares = false;
+    map.hasAttackers = false;
   }
-  
-  return false;
 }
 
 bool Board::hasKingMoved(Colour c) const {
-  return (c == Colour::White) ? whiteKingMoved : blackKingMoved;
+  return (c == Colour::White) ? state.whiteKingMoved : state.blackKingMoved;
 }
 
 bool Board::hasRookMoved(Colour c, bool kingSide) const {
   if (c == Colour::White) {
-    return kingSide ? whiteRookHMoved : whiteRookAMoved;
+    return kingSide ? state.whiteRookHMoved : state.whiteRookAMoved;
   } else {
-    return kingSide ? blackRookHMoved : blackRookAMoved;
+    return kingSide ? state.blackRookHMoved : state.blackRookAMoved;
   }
 }
 
@@ -606,9 +772,9 @@ bool Board::canCastle(Pos src, Pos dst) const {
   
   bool isWhiteKing = (piece->colour() == Colour::White);
   if (isWhiteKing) {
-    if (src.file != 4 || src.rank != 0 || whiteKingMoved) return false;
+    if (src.file != 4 || src.rank != 0 || state.whiteKingMoved) return false;
   } else {
-    if (src.file != 4 || src.rank != 7 || blackKingMoved) return false;
+    if (src.file != 4 || src.rank != 7 || state.blackKingMoved) return false;
   }
   
   bool isKingSideCastling = (dst.file > src.file);
@@ -620,11 +786,11 @@ bool Board::canCastle(Pos src, Pos dst) const {
   if (rook->colour() != piece->colour()) return false;
   
   if (isWhiteKing) {
-    if (isKingSideCastling && whiteRookHMoved) return false;
-    if (!isKingSideCastling && whiteRookAMoved) return false;
+    if (isKingSideCastling && state.whiteRookHMoved) return false;
+    if (!isKingSideCastling && state.whiteRookAMoved) return false;
   } else {
-    if (isKingSideCastling && blackRookHMoved) return false;
-    if (!isKingSideCastling && blackRookAMoved) return false;
+    if (isKingSideCastling && state.blackRookHMoved) return false;
+    if (!isKingSideCastling && state.blackRookAMoved) return false;
   }
   
   int step = isKingSideCastling ? 1 : -1;
@@ -632,68 +798,153 @@ bool Board::canCastle(Pos src, Pos dst) const {
     if (pieceAt({f, src.rank})) return false;
   }
   
-  if (isInCheck(piece->colour())) {
-    std::cout << "Cannot castle while in check." << std::endl;
-    return false;
-  }
+  if (isInCheck(piece->colour())) return false;
   
+  // The king is not in check, so lifting it cannot expose the squares it
+  // crosses: the attack map of this position answers for both
   for (int f = src.file + step; f != src.file + 3*step; f += step) {
     if (f < 0 || f > 7) break;
-    
-    Board tempBoard = *this;
-    tempBoard.grid[src.rank][src.file] = nullptr;
-    tempBoard.grid[src.rank][f] = piece;
-    if (tempBoard.isInCheck(piece->colour())) return false;
+    if (isSquareAttacked({f, src.rank}, piece->colour())) return false;
   }
   
   return true;
 } 
 
 Colour Board::getCurrentTurn() const {
-  return currentTurn;
+  return state.currentTurn;
 }
 
 void Board::clearBoard() {
-  for (int rank = 0; rank < 8; ++rank) {
-    for (int file = 0; file < 8; ++file) {
-      grid[rank][file] = nullptr;
-    }
-  }
-  
-  currentTurn = Colour::White;
-  whiteKingMoved = false;
-  blackKingMoved = false;
-  whiteRookAMoved = false;
-  whiteRookHMoved = false;
-  blackRookAMoved = false;
-  blackRookHMoved = false;
-  lastPawnDoubleMove = {-1, -1};
+  state.squares.fill('\0');
+  for (auto& side : state.pieces) {
+    for (auto& set : side) set = 0;
+  }
+  invalidateAttacks();
+  
+  state.zobristKey = 0;
+  state.pawnKey = 0;
+  state.stateKey = 0;
+  
+  state.currentTurn = Colour::White;
+  state.whiteKingMoved = false;
+  state.blackKingMoved = false;
+  state.whiteRookAMoved = false;
+  state.whiteRookHMoved = false;
+  state.blackRookAMoved = false;
+  state.blackRookHMoved = false;
+  state.lastPawnDoubleMove = {-1, -1};
+  refreshStateKey();
 }
 
 void Board::placePiece(Pos pos, char pieceType, Colour colour) {
   if (!isValidPos(pos)) return;
   
-  std::shared_ptr<Piece> piece = nullptr;
-  
-  switch (toupper(pieceType)) {
-    case 'P': piece = std::make_shared<Pawn>(colour); break;
-    case 'R': piece = std::make_shared<Rook>(colour); break;
-    case 'N': piece = std::make_shared<Knight>(colour); break;
-    case 'B': piece = std::make_shared<Bishop>(colour); break;
-    case 'Q': piece = std::make_shared<Queen>(colour); break;
-    case 'K': piece = std::make_shared<King>(colour); break;
-    default: return;
-  }
+  char symbol = static_cast<char>(toupper(pieceType));
+  const Piece* piece = Piece::get(colour == Colour::White ? symbol : tolower(symbol));
+  if (!piece) return;
   
-  grid[pos.rank][pos.file] = piece;
+  setSquare(pos, piece);
+  refreshStateKey();
 }
 
 void Board::removePiece(Pos pos) {
   if (!isValidPos(pos)) return;
   
-  grid[pos.rank][pos.file] = nullptr;
+  setSquare(pos, nullptr);
+  refreshStateKey();
 }
 
 void Board::setCurrentTurn(Colour c) {
-  currentTurn = c;
-} 
+  state.currentTurn = c;
+  refreshStateKey();
+}
+
+const BoardState& Board::snapshot() const {
+  return state;
+}
+
+uint64_t Board::hash() const {
+  return state.zobristKey;
+}
+
+uint64_t Board::pawnHash() const {
+  return state.pawnKey;
+}
+
+uint64_t Board::occupied(Colour c) const {
+  const auto& sets = state.pieces[c == Colour::White ? 0 : 1];
+  return sets[0] | sets[1] | sets[2] | sets[3] | sets[4] | sets[5];
+}
+
+uint64_t Board::pieces(Colour c, PieceType type) const {
+  return state.pieces[c == Colour::White ? 0 : 1][static_cast<int>(type)];
+}
+
+int Board::pieceCount(Colour c, PieceType type) const {
+  return std::popcount(pieces(c, type));
+}
+
+// Every square write goes through here so the keys and piece sets stay in
+// step with the grid
+void Board::setSquare(Pos p, const Piece* piece) {
+  char& square = state.squares[p.rank * 8 + p.file];
+  uint64_t bit = uint64_t{1} << (p.rank * 8 + p.file);
+  auto old = Piece::get(square);
+  if (old) {
+    uint64_t key = Zobrist::piece(old->symbol(), p);
+    state.zobristKey ^= key;
+    if (old->symbol() == 'P' || old->symbol() == 'p') state.pawnKey ^= key;
+    pieceSet(state, old->symbol()) &= ~bit;
+  }
+  if (piece) {
+    uint64_t key = Zobrist::piece(piece->symbol(), p);
+    state.zobristKey ^= key;
+    if (piece->symbol() == 'P' || piece->symbol() == 'p') state.pawnKey ^= key;
+    pieceSet(state, piece->symbol()) |= bit;
+  }
+  square = piece ? piece->symbol() : '\0';
+  invalidateAttacks();
+}
+
+// Castling, en passant and side-to-move part of the key. Castling rights also
+// require king and rook on their home squares, and the en passant file only
+// counts when a pawn of the side to move can actually capture there.
+uint64_t Board::computeStateKey() const {
+  uint64_t key = 0;
+  
+  auto isAt = [this](Pos p, char symbol) {
+    auto piece = pieceAt(p);
+    return piece && piece->symbol() == symbol;
+  };
+  
+  if (isAt({4, 0}, 'K') && !state.whiteKingMoved) {
+    if (!state.whiteRookHMoved && isAt({7, 0}, 'R')) key ^= Zobrist::castling(0);
+    if (!state.whiteRookAMoved && isAt({0, 0}, 'R')) key ^= Zobrist::castling(1);
+  }
+  if (isAt({4, 7}, 'k') && !state.blackKingMoved) {
+    if (!state.blackRookHMoved && isAt({7, 7}, 'r')) key ^= Zobrist::castling(2);
+    if (!state.blackRookAMoved && isAt({0, 7}, 'r')) key ^= Zobrist::castling(3);
+  }
+  
+  if (state.lastPawnDoubleMove.file != -1) {
+    char capturer = (state.currentTurn == Colour::White) ? 'P' : 'p';
+    for (int df : {-1, 1}) {
+      if (isAt({state.lastPawnDoubleMove.file + df, state.lastPawnDoubleMove.rank}, capturer)) {
+        key ^= Zobrist::enPassant(state.lastPawnDoubleMove.file);
+        break;
+      }
+    }
+  }
+  
+  if (state.currentTurn == Colour::White) {
+    key ^= Zobrist::whiteToMove();
+  }
+  
+  return key;
+}
+
+void Board::refreshStateKey() {
+  uint64_t key = computeStateKey();
+  state.zobristKey ^= state.stateKey ^ key;
+  state.stateKey = key;
+}
@@ -4,21 +4,47 @@
 #include "Piece.h"
 #include "Pos.h"
 #include "Colour.h"
+#include "BoardState.h"
+#include "Move.h"
+#include <array>
 #include <vector>
-#include <memory>
 #include <ostream>
+#include <cstdint>
 
+// Which legal moves to generate: captures (en passant included), the other
+// moves, or both
+enum class MoveGenType { Captures, Quiets, All };
+
+// Where the game stands for the side to move. DrawByRule is a position the
+// rules declare drawn although moves remain: neither side can ever mate.
+enum class GameStatus { Ongoing, Check, Checkmate, Stalemate, DrawByRule };
+
+// Attack queries fill a cache on the board, so one Board must not be queried
+// from several threads at once; copies are independent of each other.
 class Board {
 public:
   Board();
-  ~Board();
+  Board(const Board& other);
+  Board& operator=(const Board& other);
   bool move(Pos src, Pos dst);
   bool move(Pos src, Pos dst, char promotionPiece);
+  // Plays a move that legalMoves() returned for this position without
+  // validating it again; same result as move(), for engine use
+  void makeMove(const Move& move);
   void draw(std::ostream& os) const;
-  std::shared_ptr<Piece> pieceAt(Pos p) const;
+  const Piece* pieceAt(Pos p) const;
   bool isInCheck(Colour c) const;
+  // From the king's piece set; {-1, -1} if c has no king
+  Pos kingSquare(Colour c) const;
   bool isCheckmate(Colour c) const;
   bool isStalemate(Colour c) const;
+  // Stops at the first legal move, trying king moves and captures first
+  bool hasLegalMove(Colour c) const;
+  // Cached against hash(), so asking again for the same position is free
+  GameStatus gameStatus() const;
+  // No sequence of moves can mate: bare kings, one minor piece, or only
+  // bishops that all stand on squares of one colour
+  bool isInsufficientMaterial() const;
   bool isValidPos(Pos p) const;
   bool canEnPassantCapture(Pos src, Pos dst) const;
   bool canCastle(Pos src, Pos dst) const;
@@ -33,29 +59,68 @@ public:
   bool hasRookMoved(Colour c, bool kingSide) const;
   bool isPathClear(Pos from, Pos to) const;
   bool isSquareAttacked(Pos square, Colour defendingColour) const;
+  // Squares the side attacks (bit rank * 8 + file) and how many of its
+  // pieces attack a square; attacks through another piece do not count
+  uint64_t attackedSquares(Colour by) const;
+  int attackerCount(Pos square, Colour by) const;
+
+  // Squares holding c's pieces, all or of one type (bit rank * 8 + file)
+  uint64_t occupied(Colour c) const;
+  uint64_t pieces(Colour c, PieceType type) const;
+  int pieceCount(Colour c, PieceType type) const;
   
   bool simulateMove(Pos src, Pos dst, Colour playerColour) const;
 
+  // Appends c's legal moves of the given kind in board order (rank by rank,
+  // file by file); promotions are expanded to Q, R, B and N
+  void legalMoves(Colour c, MoveGenType type, std::vector<Move>& moves) const;
+
+  // Incrementally maintained Zobrist keys; hash() is the Polyglot key of the
+  // position and pawnHash covers pawns only
+  uint64_t hash() const;
+  uint64_t pawnHash() const;
+
+  // The raw position; Board adds the rules on top of it
+  const BoardState& snapshot() const;
+
 private:
-  std::vector<std::vector<std::shared_ptr<Piece>>> grid;
-  Colour currentTurn;
-  
-  bool whiteKingMoved = false;
-  bool blackKingMoved = false;
-  bool whiteRookAMoved = false;
-  bool whiteRookHMoved = false;
-  bool blackRookAMoved = false;
-  bool blackRookHMoved = false;
-  
-  Pos lastPawnDoubleMove = {-1, -1};
+  // Squares hold piece symbols; Piece::get maps them to the shared piece
+  // instances. Copying a Board copies only this struct.
+  BoardState state;
+
+  // Each side's attacks, computed when first needed after the position
+  // changed (the counts only when asked for). Derived data, so copies start
+  // without it.
+  struct AttackMap {
+    uint64_t squares;
+    std::array<uint8_t, 64> attackers;
+    uint8_t directQueries;  // isSquareAttacked answers given without the map
+    bool hasSquares;
+    bool hasAttackers;
+  };
+  mutable AttackMap attackMaps[2];
+
+  // Last gameStatus() answer and the hash() it was computed for
+  mutable uint64_t statusKey;
+  mutable GameStatus status;
+  mutable bool hasStatus;
 
-  std::shared_ptr<Piece> createPromotedPiece(char pieceType, Colour c);
+  void invalidateAttacks();
+  
+  const Piece* createPromotedPiece(char pieceType, Colour c);
   
   bool isCastlingMove(Pos src, Pos dst) const;
   bool isEnPassantCapture(Pos src, Pos dst) const;
   void performCastling(Pos src, Pos dst);
   void performEnPassant(Pos src, Pos dst);
-  void updateSpecialMoveTracking(Pos src, Pos dst, std::shared_ptr<Piece> piece);
+  void updateSpecialMoveTracking(Pos src, Pos dst, const Piece* piece);
+
+  template <Colour Us, MoveGenType Type>
+  void generateLegalMoves(std::vector<Move>& moves) const;
+
+  void setSquare(Pos p, const Piece* piece);
+  uint64_t computeStateKey() const;
+  void refreshStateKey();
 };
 
 #endif 
@@ -0,0 +1,40 @@
+#ifndef BOARD_STATE_H
+#define BOARD_STATE_H
+
+#include "Colour.h"
+#include "Pos.h"
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+// Piece kinds in the order of BoardState::pieces
+enum class PieceType { Pawn, Knight, Bishop, Rook, Queen, King };
+
+// Everything that defines a position, as plain data: copying a board is a
+// straight memcpy of this struct with no pointers to chase or refcounts to
+// bump, so boards can be copied freely inside (parallel) searches.
+struct alignas(64) BoardState {
+  std::array<char, 64> squares;  // piece symbol per square (rank * 8 + file), '\0' = empty
+  // The same pieces as sets, by side (White first) and PieceType: bit
+  // rank * 8 + file. Looping over these skips the empty squares.
+  uint64_t pieces[2][6];
+
+  uint64_t zobristKey;  // full Zobrist key
+  uint64_t pawnKey;     // pawns only
+  uint64_t stateKey;    // castling, en passant and side-to-move part of zobristKey
+
+  Colour currentTurn;
+  Pos lastPawnDoubleMove;
+
+  bool whiteKingMoved;
+  bool blackKingMoved;
+  bool whiteRookAMoved;
+  bool whiteRookHMoved;
+  bool blackRookAMoved;
+  bool blackRookHMoved;
+};
+
+static_assert(std::is_trivially_copyable_v<BoardState>, "BoardState must stay memcpy-able");
+static_assert(sizeof(BoardState) == 256, "BoardState should fill exactly four cache lines");
+
+#endif
@@ -0,0 +1,275 @@
+#include "EvalKernel.h"
+#include "BoardState.h"
+#include <array>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EVAL_KERNEL_X86 1
+#endif
+
+namespace {
+  const int pawnPositionBonus[8][8] = {
+    {0,  0,  0,  0,  0,  0,  0,  0},
+    {50, 50, 50, 50, 50, 50, 50, 50},
+    {10, 10, 20, 30, 30, 20, 10, 10},
+    {5,  5, 10, 25, 25, 10,  5,  5},
+    {0,  0,  0, 20, 20,  0,  0,  0},
+    {5, -5,-10,  0,  0,-10, -5,  5},
+    {5, 10, 10,-20,-20, 10, 10,  5},
+    {0,  0,  0,  0,  0,  0,  0,  0}
+  };
+  
+  const int knightPositionBonus[8][8] = {
+    {-50,-40,-30,-30,-30,-30,-40,-50},
+    {-40,-20,  0,  0,  0,  0,-20,-40},
+    {-30,  0, 10, 15, 15, 10,  0,-30},
+    {-30,  5, 15, 20, 20, 15,  5,-30},
+    {-30,  0, 15, 20, 20, 15,  0,-30},
+    {-30,  5, 10, 15, 15, 10,  5,-30},
+    {-40,-20,  0,  5,  5,  0,-20,-40},
+    {-50,-40,-30,-30,-30,-30,-40,-50}
+  };
+  
+  const int bishopPositionBonus[8][8] = {
+    {-20,-10,-10,-10,-10,-10,-10,-20},
+    {-10,  0,  0,  0,  0,  0,  0,-10},
+    {-10,  0, 10, 10, 10, 10,  0,-10},
+    {-10,  5,  5, 10, 10,  5,  5,-10},
+    {-10,  0,  5, 10, 10,  5,  0,-10},
+    {-10,  5,  5,  5,  5,  5,  5,-10},
+    {-10,  0,  5,  0,  0,  5,  0,-10},
+    {-20,-10,-10,-10,-10,-10,-10,-20}
+  };
+
+  const char kindSymbols[12] = {'P', 'N', 'B', 'R', 'Q', 'K', 'p', 'n', 'b', 'r', 'q', 'k'};
+  const int kindValues[6] = {100, 320, 330, 500, 900, 20000};
+  const int kingValue = 20000;
+
+  // Scalar version: signed weight (value plus bonus) of every symbol on every
+  // square. White pieces use the table of their type; Black pieces all use
+  // the mirrored pawn table, as evaluatePosition always has.
+  //
+  // Vector versions: the same score split into bytes, so 16 or 32 squares
+  // are handled per instruction. Values (in tenths, as every piece but the
+  // king is worth a multiple of ten) and bonuses each fit in a signed byte;
+  // kings are counted separately. Bonus rows are the white pawn, knight and
+  // bishop tables and the one used by every black piece.
+  struct WeightTable {
+    int16_t bySymbol[128][64];
+    alignas(32) int8_t bonus[4][64];
+
+    WeightTable() : bySymbol{}, bonus{} {
+      for (int rank = 0; rank < 8; ++rank) {
+        for (int file = 0; file < 8; ++file) {
+          int square = rank * 8 + file;
+          bonus[0][square] = static_cast<int8_t>(pawnPositionBonus[rank][file]);
+          bonus[1][square] = static_cast<int8_t>(knightPositionBonus[rank][file]);
+          bonus[2][square] = static_cast<int8_t>(bishopPositionBonus[rank][file]);
+          bonus[3][square] = static_cast<int8_t>(-pawnPositionBonus[7 - rank][file]);
+
+          for (int kind = 0; kind < 12; ++kind) {
+            int value = kindValues[kind % 6];
+            int weight = (kind < 6) ? value : -value;
+            if (kind >= 6) {
+              weight += bonus[3][square];
+            } else if (kind < 3) {
+              weight += bonus[kind][square];
+            }
+            bySymbol[static_cast<int>(kindSymbols[kind])][square] = static_cast<int16_t>(weight);
+          }
+        }
+      }
+    }
+  };
+
+  const WeightTable table;
+
+  int evaluateScalar(const std::array<char, 64>& squares) {
+    int score = 0;
+    for (int square = 0; square < 64; ++square) {
+      score += table.bySymbol[squares[square] & 0x7F][square];
+    }
+    return score;
+  }
+
+#ifdef EVAL_KERNEL_X86
+  // Signed bytes are summed with SAD against zero after flipping the sign
+  // bit, which adds 128 per byte; the bias is removed from the totals
+  const int byteBias = 128 * 64;
+
+  // Sum of the signed bytes accumulated in the 64-bit lanes of a SAD result
+  __attribute__((target("sse2")))
+  int foldSums(__m128i sums) {
+    return _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8)) - byteBias;
+  }
+
+  __attribute__((target("avx2")))
+  int foldSums(__m256i sums) {
+    return foldSums(_mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1)));
+  }
+
+  // Masked merge of one piece type: the lanes of match take value
+  __attribute__((target("sse2")))
+  inline __m128i select(__m128i match, __m128i value, __m128i merged) {
+    return _mm_or_si128(merged, _mm_and_si128(match, value));
+  }
+
+  // 16 squares per step. The symbol is folded to upper case and each type
+  // matched with a byte compare; values (in tenths) and king counts are
+  // merged in under the masks and negated for black pieces, while white
+  // pawns, knights and bishops take their own bonus rows.
+  __attribute__((target("sse2")))
+  int evaluateSSE2(const std::array<char, 64>& squares) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i signBit = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i upperCase = _mm_set1_epi8(static_cast<char>(0xDF));
+    const __m128i lastUpper = _mm_set1_epi8('a' - 1);
+    __m128i valueSums = zero;
+    __m128i bonusSums = zero;
+    __m128i kingSums = zero;
+
+    for (int chunk = 0; chunk < 64; chunk += 16) {
+      __m128i symbols = _mm_loadu_si128(reinterpret_cast<const __m128i*>(squares.data() + chunk));
+      __m128i black = _mm_cmpgt_epi8(symbols, lastUpper);
+      __m128i type = _mm_and_si128(symbols, upperCase);
+
+      __m128i pawns = _mm_cmpeq_epi8(type, _mm_set1_epi8('P'));
+      __m128i knights = _mm_cmpeq_epi8(type, _mm_set1_epi8('N'));
+      __m128i bishops = _mm_cmpeq_epi8(type, _mm_set1_epi8('B'));
+      __m128i rooks = _mm_cmpeq_epi8(type, _mm_set1_epi8('R'));
+      __m128i queens = _mm_cmpeq_epi8(type, _mm_set1_epi8('Q'));
+      __m128i kings = _mm_cmpeq_epi8(type, _mm_set1_epi8('K'));
+
+      __m128i values = _mm_and_si128(pawns, _mm_set1_epi8(10));
+      values = select(knights, _mm_set1_epi8(32), values);
+      values = select(bishops, _mm_set1_epi8(33), values);
+      values = select(rooks, _mm_set1_epi8(50), values);
+      values = select(queens, _mm_set1_epi8(90), values);
+      // (x ^ black) - black negates the entries of black pieces; a king
+      // mask is -1 per king, so it is negated for white instead
+      values = _mm_sub_epi8(_mm_xor_si128(values, black), black);
+      kings = _mm_sub_epi8(_mm_xor_si128(kings, black), black);
+      kings = _mm_sub_epi8(zero, kings);
+
+      const __m128i* rows = reinterpret_cast<const __m128i*>(table.bonus[0] + chunk);
+      __m128i bonuses = _mm_and_si128(black, _mm_load_si128(rows + 12));
+      bonuses = select(_mm_andnot_si128(black, pawns), _mm_load_si128(rows), bonuses);
+      bonuses = select(_mm_andnot_si128(black, knights), _mm_load_si128(rows + 4), bonuses);
+      bonuses = select(_mm_andnot_si128(black, bishops), _mm_load_si128(rows + 8), bonuses);
+
+      valueSums = _mm_add_epi64(valueSums, _mm_sad_epu8(_mm_xor_si128(values, signBit), zero));
+      bonusSums = _mm_add_epi64(bonusSums, _mm_sad_epu8(_mm_xor_si128(bonuses, signBit), zero));
+      kingSums = _mm_add_epi64(kingSums, _mm_sad_epu8(_mm_xor_si128(kings, signBit), zero));
+    }
+
+    return foldSums(valueSums) * 10 + foldSums(bonusSums) + foldSums(kingSums) * kingValue;
+  }
+
+  // 32 squares per step. Folding the symbol to upper case and hashing it
+  // with t ^ (t >> 4) gives a distinct nibble per piece type (empty is 0),
+  // so value and king count come from one shuffle lookup each; the sign is
+  // then taken from the colour.
+  __attribute__((target("avx2")))
+  int evaluateAVX2(const std::array<char, 64>& squares) {
+    // Indexed by the hashed type: Q=4, P=5, B=6, R=7, N=10, K=15
+    const __m256i valueLookup = _mm256_setr_epi8(
+        0, 0, 0, 0, 90, 10, 33, 50, 0, 0, 32, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 90, 10, 33, 50, 0, 0, 32, 0, 0, 0, 0, 0);
+    const __m256i kingLookup = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i signBit = _mm256_set1_epi8(static_cast<char>(0x80));
+    const __m256i upperCase = _mm256_set1_epi8(static_cast<char>(0xDF));
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+    const __m256i lastUpper = _mm256_set1_epi8('a' - 1);
+    __m256i valueSums = zero;
+    __m256i bonusSums = zero;
+    __m256i kingSums = zero;
+
+    for (int chunk = 0; chunk < 64; chunk += 32) {
+      __m256i symbols = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(squares.data() + chunk));
+      __m256i black = _mm256_cmpgt_epi8(symbols, lastUpper);
+
+      __m256i type = _mm256_and_si256(symbols, upperCase);
+      __m256i hashed = _mm256_and_si256(_mm256_xor_si256(type, _mm256_srli_epi16(type, 4)), lowNibble);
+      // (x ^ black) - black negates the entries of black pieces
+      __m256i values = _mm256_shuffle_epi8(valueLookup, hashed);
+      values = _mm256_sub_epi8(_mm256_xor_si256(values, black), black);
+      __m256i kings = _mm256_shuffle_epi8(kingLookup, hashed);
+      kings = _mm256_sub_epi8(_mm256_xor_si256(kings, black), black);
+
+      const __m256i* rows = reinterpret_cast<const __m256i*>(table.bonus[0] + chunk);
+      __m256i pawns = _mm256_cmpeq_epi8(symbols, _mm256_set1_epi8('P'));
+      __m256i knights = _mm256_cmpeq_epi8(symbols, _mm256_set1_epi8('N'));
+      __m256i bishops = _mm256_cmpeq_epi8(symbols, _mm256_set1_epi8('B'));
+      __m256i bonuses = _mm256_and_si256(pawns, _mm256_load_si256(rows));
+      bonuses = _mm256_or_si256(bonuses, _mm256_and_si256(knights, _mm256_load_si256(rows + 2)));
+      bonuses = _mm256_or_si256(bonuses, _mm256_and_si256(bishops, _mm256_load_si256(rows + 4)));
+      bonuses = _mm256_or_si256(bonuses, _mm256_and_si256(black, _mm256_load_si256(rows + 6)));
+
+      valueSums = _mm256_add_epi64(valueSums, _mm256_sad_epu8(_mm256_xor_si256(values, signBit), zero));
+      bonusSums = _mm256_add_epi64(bonusSums, _mm256_sad_epu8(_mm256_xor_si256(bonuses, signBit), zero));
+      kingSums = _mm256_add_epi64(kingSums, _mm256_sad_epu8(_mm256_xor_si256(kings, signBit), zero));
+    }
+
+    return foldSums(valueSums) * 10 + foldSums(bonusSums) + foldSums(kingSums) * kingValue;
+  }
+#endif
+
+  typedef int (*KernelFunction)(const std::array<char, 64>&);
+
+  KernelFunction kernelFor(EvalKernel::Isa isa) {
+#ifdef EVAL_KERNEL_X86
+    if (isa == EvalKernel::Isa::AVX2) return evaluateAVX2;
+    if (isa == EvalKernel::Isa::SSE2) return evaluateSSE2;
+#endif
+    (void)isa;
+    return evaluateScalar;
+  }
+
+  EvalKernel::Isa detectBest() {
+#ifdef EVAL_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return EvalKernel::Isa::AVX2;
+    if (__builtin_cpu_supports("sse2")) return EvalKernel::Isa::SSE2;
+#endif
+    return EvalKernel::Isa::Scalar;
+  }
+}
+
+EvalKernel::Isa EvalKernel::best() {
+  static const Isa isa = detectBest();
+  return isa;
+}
+
+bool EvalKernel::supported(Isa isa) {
+  switch (isa) {
+    case Isa::AVX2:
+      return best() == Isa::AVX2;
+    case Isa::SSE2:
+      return best() != Isa::Scalar;
+    default:
+      return true;
+  }
+}
+
+const char* EvalKernel::name(Isa isa) {
+  switch (isa) {
+    case Isa::AVX2: return "AVX2";
+    case Isa::SSE2: return "SSE2";
+    default: return "scalar";
+  }
+}
+
+int EvalKernel::evaluate(const BoardState& state) {
+  // Resolved once; afterwards each call is a single indirect call
+  static const KernelFunction kernel = kernelFor(best());
+  return kernel(state.squares);
+}
+
+int EvalKernel::evaluate(const BoardState& state, Isa isa) {
+  if (!supported(isa)) isa = Isa::Scalar;
+  return kernelFor(isa)(state.squares);
+}
@@ -0,0 +1,23 @@
+#ifndef EVAL_KERNEL_H
+#define EVAL_KERNEL_H
+
+#include "BoardState.h"
+#include <array>
+
+// Material plus piece-square score of a mailbox, from White's point of view.
+// Every piece kind has a precomputed 64-entry weight row, so the score is a
+// compare-and-accumulate over the 64 squares. Vector versions are picked at
+// runtime from what the CPU supports; all of them give the same result.
+class EvalKernel {
+public:
+  enum class Isa { Scalar, SSE2, AVX2 };
+
+  static int evaluate(const BoardState& state);
+  static int evaluate(const BoardState& state, Isa isa);
+
+  static Isa best();        // fastest version this CPU supports
+  static bool supported(Isa isa);
+  static const char* name(Isa isa);
+};
+
+#endif
@@ -3,285 +3,140 @@
 #include "Pos.h"
 #include "Colour.h"
 #include "Piece.h"
+#include "PawnHash.h"
+#include "EvalKernel.h"
+#include "Nnue.h"
+#include "RasterRenderer.h"
 #include <memory>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <poll.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
 #include <random> // Added for random number generation
 
-GameController::GameController() 
-  : board{nullptr}, 
-    gameInProgress{false}, 
-    gameOver{false}, 
+GameController::GameController(std::ostream& out) 
+  : out{out},
     setupMode{false},
-    whiteScore{0.0},
-    blackScore{0.0},
-    whitePlayerType{PlayerType::Human},
-    blackPlayerType{PlayerType::Human},
-    whiteComputerLevel{ComputerLevel::Level1},
-    blackComputerLevel{ComputerLevel::Level1},
     rng{std::random_device{}()},
-    display{nullptr},
-    window{0},
-    gc{nullptr},
+    ponderEnabled{false},
+    ponderPending{false},
+    ponderActive{false},
+    ponderStop{false},
+    ponderKey{0},
+    ponderResult({0, 0}, {0, 0}),
+    ponderFound{false},
+    ponderHits{0},
+    ponderMisses{0},
+    inputClosed{false},
+    computerDelayMs{-1},
+    computerMoveScheduled{false},
     cellSize{70},
-    graphicsActive{false} {
-  whiteSquareColor = 0xF0D9B5;
-  blackSquareColor = 0xB58863;
-  whitePieceColor = 0xFFFFFF;
-  blackPieceColor = 0x000000;
-  textColor = 0x000000;
-}
+    graphicsActive{false},
+    interactive{true},
+    graphicsCloseScheduled{false},
+    recordFrameCount{0},
+    recordedHash{0},
+    selectionActive{false},
+    selectedSquare{-1, -1},
+    selectionKey{0},
+    legalMoveCacheKey{0},
+    legalMoveCacheValid{false},
+    quitAfterAnalysis{false},
+    wakePipe{-1, -1} {}
 
 GameController::~GameController() {
-    if (display) {
-        if (gc) XFreeGC(display, gc);
-        XCloseDisplay(display);
-    }
+    cancelComputerMove();
+    stopPondering();
+    workers.reset();  // the wake pipe outlives every job
+    if (wakePipe[0] >= 0) close(wakePipe[0]);
+    if (wakePipe[1] >= 0) close(wakePipe[1]);
 }
 
 bool GameController::initGraphics() {
-    // Open display
-    display = XOpenDisplay(nullptr);
-    if (!display) {
-        std::cerr << "Cannot open display" << std::endl;
+    if (!interactive) return false;
+    selectionActive = false;
+    graphicsCloseScheduled = false;
+    graphics = std::make_unique<X11Renderer>(cellSize);
+    if (!graphics->open()) {
+        graphics.reset();
         return false;
     }
-    
-    // Get default screen
-    int screen = DefaultScreen(display);
-    
-    // Calculate window size with padding
-    int boardSize = cellSize * 8;
-    int windowWidth = boardSize + 40;   // Add padding for coordinates
-    int windowHeight = boardSize + 40;  // Add padding for coordinates
-    
-    // Create window
-    window = XCreateSimpleWindow(
-        display,
-        RootWindow(display, screen),
-        100, 100,                      // position
-        windowWidth, windowHeight,     // size with padding
-        1,                             // border width
-        BlackPixel(display, screen),   // border color
-        0xD2B48C                       // background color (tan)
-    );
-    
-    // Set window title
-    XStoreName(display, window, "Chess");
-    
-    // Set window size hints to prevent resizing
-    XSizeHints sizeHints;
-    sizeHints.flags = PMinSize | PMaxSize;
-    sizeHints.min_width = windowWidth;
-    sizeHints.min_height = windowHeight;
-    sizeHints.max_width = windowWidth;
-    sizeHints.max_height = windowHeight;
-    XSetWMNormalHints(display, window, &sizeHints);
-    
-    // Select input events
-    XSelectInput(display, window, ExposureMask | ButtonPressMask | KeyPressMask);
-    
-    // Create graphics context
-    gc = XCreateGC(display, window, 0, nullptr);
-    
-    // Map window
-    XMapWindow(display, window);
-    
-    // Force exposure event
-    XFlush(display);
-    
     return true;
 }
 
 void GameController::closeGraphics() {
-    if (display) {
-        XDestroyWindow(display, window);
-        XFlush(display);
-    }
+    graphics.reset();
+    graphicsCloseScheduled = false;
 }
 
-void GameController::drawPieceSprite(int x, int y, char symbol) const {
-    if (!display || !gc) return;
-    
-    // Set appropriate color for the piece
-    bool isWhitePiece = (symbol >= 'A' && symbol <= 'Z');
-    XSetForeground(display, gc, isWhitePiece ? whitePieceColor : blackPieceColor);
-    
-    // Always use uppercase for the pattern
-    char upperSymbol = toupper(symbol);
-    
-    // Size of each pixel block
-    int pixelSize = cellSize / 10;
-    
-    int offsetX = x + (cellSize - pixelSize * 5) / 2;
-    int offsetY = y + (cellSize - pixelSize * 7) / 2;
-    
-    // Define simple pixelated letters (1 = pixel, 0 = empty)
-    // Classic 5x7 pixel font patterns
-    const int P[7][5] = {
-        {1,1,1,1,0},
-        {1,0,0,0,1},
-        {1,0,0,0,1},
-        {1,1,1,1,0},
-        {1,0,0,0,0},
-        {1,0,0,0,0},
-        {1,0,0,0,0}
-    };
-    
-    const int N[7][5] = {
-        {1,0,0,0,1},
-        {1,1,0,0,1},
-        {1,0,1,0,1},
-        {1,0,0,1,1},
-        {1,0,0,0,1},
-        {1,0,0,0,1},
-        {1,0,0,0,1}
-    };
-    
-    const int B[7][5] = {
-        {1,1,1,1,0},
-        {1,0,0,0,1},
-        {1,0,0,0,1},
-        {1,1,1,1,0},
-        {1,0,0,0,1},
-        {1,0,0,0,1},
-        {1,1,1,1,0}
-    };
-    
-    const int R[7][5] = {
-        {1,1,1,1,0},
-        {1,0,0,0,1},
-        {1,0,0,0,1},
-        {1,1,1,1,0},
-        {1,0,1,0,0},
-        {1,0,0,1,0},
-        {1,0,0,0,1}
-    };
-    
-    const int Q[7][5] = {
-        {0,1,1,1,0},
-        {1,0,0,0,1},
-        {1,0,0,0,1},
-        {1,0,0,0,1},
-        {1,0,1,0,1},
-        {1,0,0,1,0},
-        {0,1,1,0,1}
-    };
-    
-    const int K[7][5] = {
-        {1,0,0,0,1},
-        {1,0,0,1,0},
-        {1,0,1,0,0},
-        {1,1,0,0,0},
-        {1,0,1,0,0},
-        {1,0,0,1,0},
-        {1,0,0,0,1}
-    };
-    
-    // Choose the correct letter pattern
-    const int (*letterPattern)[5] = nullptr;
-    switch (upperSymbol) {
-        case 'P': letterPattern = P; break;
-        case 'N': letterPattern = N; break;
-        case 'B': letterPattern = B; break;
-        case 'R': letterPattern = R; break;
-        case 'Q': letterPattern = Q; break;
-        case 'K': letterPattern = K; break;
-        default: return; // Invalid symbol
-    }
-    
-    for (int row = 0; row < 7; row++) {
-        for (int col = 0; col < 5; col++) {
-            if (letterPattern[row][col] == 1) {
-                XFillRectangle(display, window, gc,
-                    offsetX + col * pixelSize,
-                    offsetY + row * pixelSize,
-                    pixelSize,
-                    pixelSize);
-            }
-        }
-    }
+// Close the window after delayMs without stalling the loop: run() closes it
+// when the time comes, unless a new window replaced it by then
+void GameController::closeGraphicsLater(int delayMs) {
+    if (!graphicsActive) return;
+    graphicsCloseScheduled = true;
+    graphicsCloseDue = std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs);
 }
 
-void GameController::renderGraphics() const {
-  if (!display || !board) return;
-  
-  // Draw board squares
-  for (int rank = 0; rank < 8; ++rank) {
-      for (int file = 0; file < 8; ++file) {
-          // Calculate position with offset for coordinates
-          int x = file * cellSize + 20;  // Offset for rank numbers on left
-          int y = (7 - rank) * cellSize + 20;  // Offset for file letters on bottom
-          
-          // Set square color
-          unsigned long squareColor = ((rank + file) % 2 == 0) ? whiteSquareColor : blackSquareColor;
-          XSetForeground(display, gc, squareColor);
-          
-          // Draw square
-          XFillRectangle(display, window, gc, x, y, cellSize, cellSize);
-          
-          // Draw piece if present
-          auto piece = board->pieceAt({file, rank});
-          if (piece) {
-              // Get piece symbol
-              char symbol = piece->symbol();
-              
-              // Draw the piece sprite
-              drawPieceSprite(x, y, symbol);
-          }
+// Show the board in the window and add a frame to the recording, if either
+// is active. Expose redraws leave the position unchanged and add no frame.
+void GameController::renderGraphics(bool fullRefresh) {
+  const Board* board = currentBoard();
+  if (!board) return;
+  
+  if (graphicsActive && graphics) {
+      // A selection made in an earlier position no longer applies
+      if (selectionActive && board->hash() != selectionKey) {
+          clearSelection();
       }
+      graphics->render(*board, fullRefresh);
   }
   
-  // Draw file labels (a-h)
-  XSetForeground(display, gc, textColor);
-  for (int file = 0; file < 8; ++file) {
-      char label = 'a' + file;
-      
-      // Draw at bottom
-      XDrawString(display, window, gc,
-                  file * cellSize + cellSize/2 + 20,  // Add offset
-                  8 * cellSize + 35,  // Below the board
-                  &label, 1);
-  }
-  
-  // Draw rank labels (1-8)
-  for (int rank = 0; rank < 8; ++rank) {
-      char label = '1' + rank;
-      
-      // Draw at left side
-      XDrawString(display, window, gc,
-                  10,  // Left of the board
-                  (7 - rank) * cellSize + cellSize/2 + 20,  // Add offset
-                  &label, 1);
+  if (recorder && board->hash() != recordedHash) {
+      recordedHash = board->hash();
+      recorder->render(*board);
       
-      XDrawString(display, window, gc,
-                  8 * cellSize + 30,
-                  (7 - rank) * cellSize + cellSize/2 + 20,
-                  &label, 1);
+      char name[32];
+      snprintf(name, sizeof(name), "/frame%04d.", recordFrameCount++);
+      std::string path = recordDirectory + name + recordFormat;
+      if (!recorder->save(path)) {
+          out << "Could not write " << path << ". Recording stopped.\n";
+          recorder.reset();
+      }
   }
-  
-  // Flush all pending operations
-  XFlush(display);
 }
 
 bool GameController::processGraphicsEvents() {
-  if (!display) return false;
+  if (!graphics) return false;
   
-  if (XPending(display)) {
+  // Drain the whole queue, redrawing at most once for a burst of exposes.
+  // A click can finish the game and close the window, so the display is
+  // looked up again on every iteration.
+  bool needsRedraw = false;
+  
+  while (graphics && XPending(graphics->display())) {
       XEvent event;
-      XNextEvent(display, &event);
+      XNextEvent(graphics->display(), &event);
       
       switch (event.type) {
           case Expose:
-              // Redraw the window
-              renderGraphics();
+              // The back buffer is intact, it just has to be copied again
+              needsRedraw = true;
               break;
           
           case ButtonPress:
-              // Handle mouse clicks (for future implementation)
+              if (event.xbutton.button == Button1) {
+                  handleBoardClick(event.xbutton.x, event.xbutton.y);
+              }
               break;
               
           case KeyPress:
@@ -298,9 +153,79 @@ bool GameController::processGraphicsEvents() {
       }
   }
   
+  if (needsRedraw) {
+      renderGraphics(true);
+  }
+  
   return true;
 }
 
+// First click selects one of the mover's pieces and highlights where it can
+// go; clicking a highlighted square plays the move as if it had been typed.
+// Clicking anywhere else moves or drops the selection. Clicks are ignored
+// while an analysis runs, as typed moves are held back.
+void GameController::handleBoardClick(int x, int y) {
+  if (setupMode || !session.inProgress() || session.isComputerTurn() || analysisRunning()) return;
+  
+  Pos square{-1, -1};
+  bool onBoard = graphics->squareAt(x, y, square);
+  const std::vector<Move>& moves = cachedLegalMoves();
+  
+  if (onBoard && selectionActive) {
+      for (const Move& move : moves) {
+          if (move.from.file == selectedSquare.file && move.from.rank == selectedSquare.rank &&
+              move.to.file == square.file && move.to.rank == square.rank) {
+              clearSelection();
+              
+              // Promotions default to a queen, as with a typed move
+              std::string command = "move ";
+              command += static_cast<char>('a' + move.from.file);
+              command += static_cast<char>('1' + move.from.rank);
+              command += ' ';
+              command += static_cast<char>('a' + move.to.file);
+              command += static_cast<char>('1' + move.to.rank);
+              out << command << std::endl;
+              processCommand(command);
+              out << "Enter command: " << std::flush;
+              return;
+          }
+      }
+  }
+  
+  clearSelection();
+  if (onBoard) {
+      for (const Move& move : moves) {
+          if (move.from.file != square.file || move.from.rank != square.rank) continue;
+          if (!selectionActive) {
+              selectionActive = true;
+              selectedSquare = square;
+              selectionKey = session.board().hash();
+              graphics->setHighlight(square, Renderer::Highlight::Selected);
+          }
+          graphics->setHighlight(move.to, Renderer::Highlight::Destination);
+      }
+  }
+  renderGraphics();
+}
+
+void GameController::clearSelection() {
+  selectionActive = false;
+  if (graphics) {
+      graphics->clearHighlights();
+  }
+}
+
+// Legal moves of the side to move, regenerated only when the position changes
+const std::vector<Move>& GameController::cachedLegalMoves() {
+  uint64_t key = session.board().hash();
+  if (!legalMoveCacheValid || key != legalMoveCacheKey) {
+      legalMoveCache = session.legalMoves();
+      legalMoveCacheKey = key;
+      legalMoveCacheValid = true;
+  }
+  return legalMoveCache;
+}
+
 Pos GameController::parsePos(const std::string& pos) {
   if (pos.length() != 2) return {-1, -1};
   
@@ -317,31 +242,50 @@ bool GameController::processCommand(const std::string& cmd) {
   std::string command;
   iss >> command;
   
+  // A server client must not read or write the server's files, nor tie up
+  // an I/O thread with table generation or benchmarks
+  if (!interactive && (command == "book" || command == "tbgen" || command == "tb" || command == "nnue" ||
+                       command == "bench" || command == "snapshot" || command == "record")) {
+    out << "'" << command << "' is not available in server sessions.\n";
+    return true;
+  }
+  
+  // A server client's lines arrive while the analysis runs; the terminal
+  // loop holds them back instead. Quitting waits for the lines.
+  if (analysisRunning() && command != "stop") {
+    if (command == "quit" || command == "exit") {
+      quitAfterAnalysis = true;
+    } else {
+      out << "Analysis in progress. Send 'stop' to end it.\n";
+    }
+    return true;
+  }
+  
   if (command == "setup") {
-    if (gameInProgress) {
-      std::cout << "Cannot enter setup mode while a game is in progress.\n";
+    if (session.inProgress()) {
+      out << "Cannot enter setup mode while a game is in progress.\n";
       return true;
     }
     
     // Initialize a new empty board for setup
-    board = std::make_shared<Board>();
-    board->clearBoard();
+    setupBoard = Board();
+    setupBoard.clearBoard();
     setupMode = true;
-    std::cout << "Entering setup mode.\n";
+    out << "Entering setup mode.\n";
     
     // Check if graphics are already active
-    if (!graphicsActive) {
+    if (!graphicsActive && interactive) {
       // Ask if user wants graphics during setup
-      std::cout << "Enable graphics for setup? (y/n): ";
+      out << "Enable graphics for setup? (y/n): ";
       std::string response;
-      std::getline(std::cin, response);
+      readLine(response);
       if (response == "y" || response == "Y" || response == "yes" || response == "Yes") {
         graphicsActive = initGraphics();
         if (graphicsActive) {
-          std::cout << "Graphics initialized successfully!" << std::endl;
+          out << "Graphics initialized successfully!" << std::endl;
           renderGraphics();
         } else {
-          std::cout << "Graphics initialization failed. Running in text-only mode." << std::endl;
+          out << "Graphics initialization failed. Running in text-only mode." << std::endl;
         }
       }
     } else {
@@ -349,7 +293,7 @@ bool GameController::processCommand(const std::string& cmd) {
       renderGraphics();
     }
     
-    board->draw(std::cout);
+    setupBoard.draw(out);
     return true;
   }
   else if (command == "game") {
@@ -359,14 +303,14 @@ bool GameController::processCommand(const std::string& cmd) {
     if ((player1 == "human" || player1 == "computer") && 
         (player2 == "human" || player2 == "computer")) {
       
-      if (gameInProgress) {
-        std::cout << "A game is already in progress. Please resign or finish the current game before starting a new one.\n";
+      if (session.inProgress()) {
+        out << "A game is already in progress. Please resign or finish the current game before starting a new one.\n";
         return true;
       }
       
       // Set player types
-      whitePlayerType = (player1 == "human") ? PlayerType::Human : PlayerType::Computer;
-      blackPlayerType = (player2 == "human") ? PlayerType::Human : PlayerType::Computer;
+      PlayerType whitePlayerType = (player1 == "human") ? PlayerType::Human : PlayerType::Computer;
+      PlayerType blackPlayerType = (player2 == "human") ? PlayerType::Human : PlayerType::Computer;
       
       // Parse level parameters
       int whiteLevel = 1;
@@ -426,56 +370,52 @@ bool GameController::processCommand(const std::string& cmd) {
       }
       
       // Set computer levels (clamp between 1 and 4)
+      whiteLevel = std::max(1, std::min(4, whiteLevel));
+      blackLevel = std::max(1, std::min(4, blackLevel));
       if (whitePlayerType == PlayerType::Computer) {
-        whiteLevel = std::max(1, std::min(4, whiteLevel));
-        whiteComputerLevel = static_cast<ComputerLevel>(whiteLevel - 1);
-        std::cout << "White computer player set to level " << whiteLevel << std::endl;
+        out << "White computer player set to level " << whiteLevel << std::endl;
       }
       
       if (blackPlayerType == PlayerType::Computer) {
-        blackLevel = std::max(1, std::min(4, blackLevel));
-        blackComputerLevel = static_cast<ComputerLevel>(blackLevel - 1);
-        std::cout << "Black computer player set to level " << blackLevel << std::endl;
+        out << "Black computer player set to level " << blackLevel << std::endl;
       }
       
-      board = std::make_shared<Board>();
-      gameInProgress = true;
-      gameOver = false;
+      // A search still running for the previous game is abandoned
+      cancelComputerMove();
+      
+      session.setPlayer(Colour::White, whitePlayerType, static_cast<ComputerLevel>(whiteLevel - 1));
+      session.setPlayer(Colour::Black, blackPlayerType, static_cast<ComputerLevel>(blackLevel - 1));
+      session.start();
       
       // Initialize graphics
       graphicsActive = initGraphics();
       
       if (graphicsActive) {
-        std::cout << "Graphics initialized successfully!" << std::endl;
-        renderGraphics();
-      } else {
-        std::cout << "Graphics initialization failed. Running in text-only mode." << std::endl;
+        out << "Graphics initialized successfully!" << std::endl;
+      } else if (interactive) {
+        out << "Graphics initialization failed. Running in text-only mode." << std::endl;
       }
+      renderGraphics();
       
-      board->draw(std::cout);
+      session.board().draw(out);
       
       // Show whose turn it is
-      Colour currentPlayer = board->getCurrentTurn();
-      std::cout << "\n" << (currentPlayer == Colour::White ? "White" : "Black") << " to play." << std::endl;
+      Colour currentPlayer = session.board().getCurrentTurn();
+      out << "\n" << (currentPlayer == Colour::White ? "White" : "Black") << " to play." << std::endl;
       
-      // If the first player is a computer, make its move
-      if ((currentPlayer == Colour::White && whitePlayerType == PlayerType::Computer) ||
-          (currentPlayer == Colour::Black && blackPlayerType == PlayerType::Computer)) {
-        makeComputerMove();
-      }
     } else {
-      std::cout << "Invalid game mode. Use 'game human human', 'game human computer', 'game computer human', or 'game computer computer'.\n";
-      std::cout << "You can also specify computer level with 'level<N>' where N is 1-4, e.g., 'game human computer level2'.\n";
+      out << "Invalid game mode. Use 'game human human', 'game human computer', 'game computer human', or 'game computer computer'.\n";
+      out << "You can also specify computer level with 'level<N>' where N is 1-4, e.g., 'game human computer level2'.\n";
     }
   } else if (command == "castle") {
-    if (!gameInProgress) {
-      std::cout << "No game in progress. Use 'game human human' to start.\n";
+    if (!session.inProgress()) {
+      out << "No game in progress. Use 'game human human' to start.\n";
       return true;
     }
     
     // Check if it's a human player's turn
-    if (isComputerTurn()) {
-      std::cout << "It's the computer's turn. Please wait.\n";
+    if (session.isComputerTurn()) {
+      out << "It's the computer's turn. Please wait.\n";
       return true;
     }
     
@@ -485,77 +425,60 @@ bool GameController::processCommand(const std::string& cmd) {
     bool success = false;
     if (side == "kingside" || side == "k") {
       // Determine king's position based on current player
-      int rank = (board->getCurrentTurn() == Colour::White) ? 0 : 7;
+      int rank = (session.board().getCurrentTurn() == Colour::White) ? 0 : 7;
       Pos kingPos{4, rank};
       Pos destPos{6, rank};
-      success = board->move(kingPos, destPos);
+      success = session.apply(Move(kingPos, destPos));
     } else if (side == "queenside" || side == "q") {
       // Determine king's position based on current player
-      int rank = (board->getCurrentTurn() == Colour::White) ? 0 : 7;
+      int rank = (session.board().getCurrentTurn() == Colour::White) ? 0 : 7;
       Pos kingPos{4, rank};
       Pos destPos{2, rank};
-      success = board->move(kingPos, destPos);
+      success = session.apply(Move(kingPos, destPos));
     } else {
-      std::cout << "Invalid castling command. Use 'castle kingside' or 'castle queenside'.\n";
+      out << "Invalid castling command. Use 'castle kingside' or 'castle queenside'.\n";
       return true;
     }
     
     if (success) {
       // Update graphics if active
-      if (graphicsActive) {
-        renderGraphics();
-      }
+      renderGraphics();
       
-      board->draw(std::cout);
+      const Board& position = session.board();
+      position.draw(out);
       
-      // Check for check/checkmate/stalemate
-      Colour currentPlayerColour = board->getCurrentTurn();
-      if (board->isInCheck(currentPlayerColour)) {
-        if (board->isCheckmate(currentPlayerColour)) {
-          std::cout << (currentPlayerColour == Colour::White ? "Black" : "White") << " wins!" << std::endl;
-          incrementScore(currentPlayerColour == Colour::White ? Colour::Black : Colour::White);
-          gameInProgress = false;
-          gameOver = true;
-          
-          // Close graphics window
-          if (graphicsActive) {
-            sleep(2); // Give user a moment to see the final position
-            closeGraphics();
-            graphicsActive = false;
-          }
-        } else {
-          std::cout << "Check!" << std::endl;
-        }
-      } else if (board->isStalemate(currentPlayerColour)) {
-        std::cout << "Stalemate! The game is a draw." << std::endl;
-        incrementDrawScore();
-        gameInProgress = false;
-        gameOver = true;
+      // Check for check/checkmate/stalemate; the session has scored the result
+      Colour currentPlayerColour = position.getCurrentTurn();
+      GameResult result = session.result();
+      if (result == GameResult::WhiteWins || result == GameResult::BlackWins) {
+        out << (currentPlayerColour == Colour::White ? "Black" : "White") << " wins!" << std::endl;
         
-        // Close graphics window
-        if (graphicsActive) {
-          sleep(2); // Give user a moment to see the final position
-          closeGraphics();
-          graphicsActive = false;
-        }
+        // Close the window once the user has seen the final position
+        closeGraphicsLater(2000);
+      } else if (result == GameResult::Draw) {
+        out << (session.board().gameStatus() == GameStatus::DrawByRule ? "Insufficient material!" : "Stalemate!")
+            << " The game is a draw." << std::endl;
+        
+        // Close the window once the user has seen the final position
+        closeGraphicsLater(2000);
+      } else if (position.gameStatus() == GameStatus::Check) {
+        out << "Check!" << std::endl;
       }
       
-      // If the next player is a computer, make its move
-      if (gameInProgress && isComputerTurn()) {
-        makeComputerMove();
-      }
+    } else if (session.board().isInCheck(session.board().getCurrentTurn())) {
+      out << "Cannot castle while in check.\n";
     } else {
-      std::cout << "Invalid castling move.\n";
+      out << "Invalid castling move.\n";
     }
   } else if (command == "move") {
-    if (!gameInProgress) {
-      std::cout << "No game in progress. Use 'game human human' to start.\n";
+    if (!session.inProgress()) {
+      out << "No game in progress. Use 'game human human' to start.\n";
       return true;
     }
     
     // Check if it's a human player's turn
-    if (isComputerTurn()) {
-      std::cout << "It's the computer's turn. Please wait.\n";
+    if (session.isComputerTurn()) {
+      out << "It's the computer's turn. Please wait.\n";
       return true;
     }
     
@@ -566,135 +489,410 @@ bool GameController::processCommand(const std::string& cmd) {
     Pos dst = parsePos(dst_str);
     
     if (src.file == -1 || dst.file == -1) {
-      std::cout << "Invalid position format. Use algebraic notation (e.g., e2 e4).\n";
+      out << "Invalid position format. Use algebraic notation (e.g., e2 e4).\n";
       return true;
     }
     
-    // Check for castling attempt
-    if (board->pieceAt(src) && (board->pieceAt(src)->symbol() == 'K' || board->pieceAt(src)->symbol() == 'k') && abs(dst.file - src.file) == 2) {
-      if (board->isInCheck(board->pieceAt(src)->colour())) {
-        std::cout << "Warning: You cannot castle while in check!\n";
-      }
-    }
-    
-    bool moveSuccess = false;
+    // A king moving two files is a castling attempt
+    const Board& board = session.board();
+    bool castling = board.pieceAt(src) && (board.pieceAt(src)->symbol() == 'K' || board.pieceAt(src)->symbol() == 'k') &&
+                    abs(dst.file - src.file) == 2;
     
     // Check if promotion piece is specified
+    char promotionPiece = '\0';
     if (!promotion_str.empty() && promotion_str.length() == 1) {
-      char promotionPiece = promotion_str[0];
-      moveSuccess = board->move(src, dst, promotionPiece);
-    } else {
-      moveSuccess = board->move(src, dst);
+      promotionPiece = promotion_str[0];
     }
     
-    if (moveSuccess) {
+    if (session.apply(Move(src, dst, promotionPiece))) {
       // Update graphics if active
-      if (graphicsActive) {
-        renderGraphics();
-      }
+      renderGraphics();
       
-      board->draw(std::cout);
+      board.draw(out);
       
       // After a move, the current player is the one whose turn it is now
       // The piece at the destination belongs to the player who just moved
-      Colour currentPlayerColour = board->getCurrentTurn();
+      Colour currentPlayerColour = board.getCurrentTurn();
       
       // Show whose turn it is
-      std::cout << "\n" << (currentPlayerColour == Colour::White ? "White" : "Black") << " to play." << std::endl;
+      out << "\n" << (currentPlayerColour == Colour::White ? "White" : "Black") << " to play." << std::endl;
       
-      // Check if the current player is in check
-      if (board->isInCheck(currentPlayerColour)) {
-        // Check if it's checkmate
-        if (board->isCheckmate(currentPlayerColour)) {
-          std::cout << "Checkmate! " << (currentPlayerColour == Colour::White ? "Black" : "White") << " wins!" << std::endl;
-          incrementScore(currentPlayerColour == Colour::White ? Colour::Black : Colour::White);
-          gameInProgress = false;
-          gameOver = true;
-          
-          // Close graphics window
-          if (graphicsActive) {
-            sleep(2); // Give user a moment to see the final position
-            closeGraphics();
-            graphicsActive = false;
-          }
-        } else {
-          std::cout << "Check!" << std::endl;
-        }
-      } else if (board->isStalemate(currentPlayerColour)) {
-        std::cout << "Stalemate! The game is a draw." << std::endl;
-        incrementDrawScore();
-        gameInProgress = false;
-        gameOver = true;
+      // Checkmate and stalemate have been scored by the session
+      GameResult result = session.result();
+      if (result == GameResult::WhiteWins || result == GameResult::BlackWins) {
+        out << "Checkmate! " << (currentPlayerColour == Colour::White ? "Black" : "White") << " wins!" << std::endl;
         
-        // Close graphics window
-        if (graphicsActive) {
-          sleep(2); // Give user a moment to see the final position
-          closeGraphics();
-          graphicsActive = false;
-        }
+        // Close the window once the user has seen the final position
+        closeGraphicsLater(2000);
+      } else if (result == GameResult::Draw) {
+        out << (session.board().gameStatus() == GameStatus::DrawByRule ? "Insufficient material!" : "Stalemate!")
+            << " The game is a draw." << std::endl;
+        
+        // Close the window once the user has seen the final position
+        closeGraphicsLater(2000);
+      } else if (board.gameStatus() == GameStatus::Check) {
+        out << "Check!" << std::endl;
       }
       
-      // If the next player is a computer, make its move
-      if (gameInProgress && isComputerTurn()) {
-        makeComputerMove();
-      }
+    } else if (castling && board.isInCheck(board.getCurrentTurn())) {
+      out << "Cannot castle while in check.\n";
     } else {
-      std::cout << "Invalid move.\n";
+      out << "Invalid move.\n";
     }
   } else if (command == "resign") {
-    if (!gameInProgress) {
-      std::cout << "No game in progress.\n";
+    if (!session.inProgress()) {
+      out << "No game in progress.\n";
       return true;
     }
     
-    // Check if it's a human player's turn
-    if (isComputerTurn()) {
-      std::cout << "Computer players cannot resign. Use 'game human human' to start a new game.\n";
-      return true;
+    // While the computer is thinking its human opponent may still resign
+    Colour resigning = session.board().getCurrentTurn();
+    if (session.isComputerTurn()) {
+      Colour opponent = (resigning == Colour::White) ? Colour::Black : Colour::White;
+      if (session.playerType(opponent) == PlayerType::Computer) {
+        out << "Computer players cannot resign. Use 'game human human' to start a new game.\n";
+        return true;
+      }
+      resigning = opponent;
     }
     
-    std::cout << (board->getCurrentTurn() == Colour::White ? "White" : "Black") << " resigns. ";
-    std::cout << (board->getCurrentTurn() == Colour::White ? "Black" : "White") << " wins!" << std::endl;
-    incrementScore(board->getCurrentTurn() == Colour::White ? Colour::Black : Colour::White);
-    gameInProgress = false;
-    gameOver = true;
+    cancelComputerMove();
+    out << (resigning == Colour::White ? "White" : "Black") << " resigns. ";
+    out << (resigning == Colour::White ? "Black" : "White") << " wins!" << std::endl;
+    session.resign(resigning);
+    stopPondering();
     
-    // Close graphics window
-    if (graphicsActive) {
-      sleep(1); // Give user a moment to see the final position
-      closeGraphics();
-      graphicsActive = false;
-    }
+    // Close the window once the user has seen the final position
+    closeGraphicsLater(1000);
   } else if (command == "draw") {
-    if (!gameInProgress) {
-      std::cout << "No active game. Start with 'game human human'.\n";
+    if (!session.inProgress()) {
+      out << "No active game. Start with 'game human human'.\n";
     } else {
-      board->draw(std::cout);
+      session.board().draw(out);
     }
   } else if (command == "score") {
     printScore();
     return true;
+  } else if (command == "book") {
+    std::string path;
+    iss >> path;
+    
+    // A running search keeps the book it started with; restarting it (from
+    // the main loop) makes the change apply to the current move as well
+    if (!path.empty()) {
+      cancelComputerMove();
+    }
+    
+    std::shared_ptr<const OpeningBook> book = session.getBook();
+    if (path.empty()) {
+      if (book) {
+        out << "Opening book loaded (" << book->size() << " entries).\n";
+      } else {
+        out << "No opening book loaded. Use 'book <path>' to load one.\n";
+      }
+    } else if (path == "off") {
+      session.setBook(nullptr);
+      out << "Opening book disabled.\n";
+    } else {
+      auto opened = std::make_shared<OpeningBook>();
+      if (opened->open(path)) {
+        session.setBook(opened);
+        out << "Opening book loaded (" << opened->size() << " entries).\n";
+      } else {
+        session.setBook(nullptr);
+        out << "Could not open book file: " << path << "\n";
+      }
+    }
+    return true;
+  } else if (command == "tbgen") {
+    std::string directory;
+    iss >> directory;
+    
+    if (directory.empty()) {
+      out << "Usage: tbgen <directory> [material...] (e.g. 'tbgen tables KQK KRK')\n";
+      return true;
+    }
+    
+    std::vector<std::string> materials;
+    std::string material;
+    while (iss >> material) {
+      materials.push_back(material);
+    }
+    if (materials.empty()) {
+      materials = Tablebase::defaultMaterials();
+    }
+    
+    if (Tablebase::generate(directory, materials, out)) {
+      out << "Tablebases written to " << directory << "\n";
+    } else {
+      out << "Tablebase generation failed.\n";
+    }
+    return true;
+  } else if (command == "tb") {
+    std::string directory;
+    iss >> directory;
+    
+    if (!directory.empty()) {
+      cancelComputerMove();
+    }
+    
+    std::shared_ptr<const Tablebase> tablebase = session.getTablebase();
+    if (directory == "off") {
+      session.setTablebase(nullptr);
+      out << "Tablebases disabled.\n";
+    } else if (directory.empty()) {
+      out << (tablebase ? tablebase->tableCount() : 0) << " tablebase(s) loaded.\n";
+    } else {
+      auto opened = std::make_shared<Tablebase>();
+      if (opened->open(directory) > 0) {
+        session.setTablebase(opened);
+        out << opened->tableCount() << " tablebase(s) loaded from " << directory << ".\n";
+      } else {
+        session.setTablebase(nullptr);
+        out << "No tablebases found in " << directory << "\n";
+      }
+    }
+    return true;
+  } else if (command == "nnue") {
+    std::string path;
+    iss >> path;
+    
+    if (path.empty()) {
+      std::shared_ptr<const NnueNetwork> nnue = session.getNetwork();
+      if (nnue) {
+        out << "Network loaded (" << nnue->hiddenSize() << " hidden, " << nnue->denseSize() << " dense units).\n";
+      } else {
+        out << "No network loaded. Use 'nnue <file>' to load one.\n";
+      }
+      return true;
+    }
+    
+    // Searches and pondering restart with the new weights
+    cancelComputerMove();
+    stopPondering();
+    auto nnue = std::make_shared<NnueNetwork>();
+    if (nnue->load(path)) {
+      session.setNetwork(nnue);
+      out << "Network loaded from " << path << " (" << nnue->hiddenSize() << " hidden, "
+                << nnue->denseSize() << " dense units).\n";
+    } else {
+      out << "Could not load network file: " << path << "\n";
+    }
+    return true;
+  } else if (command == "eval") {
+    std::string levelStr, type;
+    iss >> levelStr >> type;
+    
+    if (levelStr.length() > 5 && levelStr.substr(0, 5) == "level") {
+      levelStr = levelStr.substr(5);
+    }
+    int level = 0;
+    try {
+      level = std::stoi(levelStr);
+    } catch (...) {
+      level = 0;
+    }
+    
+    if (level < 1 || level > 4 || (type != "classic" && type != "nnue")) {
+      out << "Usage: eval <level> classic|nnue\n";
+      for (int i = 0; i < 4; ++i) {
+        out << "  Level " << (i + 1) << ": "
+                  << (session.evalSetting(static_cast<ComputerLevel>(i)) == EvalType::Nnue ? "nnue" : "classic") << "\n";
+      }
+      return true;
+    }
+    
+    cancelComputerMove();
+    stopPondering();
+    session.setEval(static_cast<ComputerLevel>(level - 1), (type == "nnue") ? EvalType::Nnue : EvalType::Classic);
+    out << "Level " << level << " computer players use the " << type << " evaluation.\n";
+    if (level < 4) {
+      out << "Note: only level 4 evaluates positions; lower levels are unaffected.\n";
+    }
+    if (type == "nnue" && !session.getNetwork()) {
+      out << "No network loaded yet; the classic evaluation is used until 'nnue <file>'.\n";
+    }
+    return true;
+  } else if (command == "delay") {
+    std::string value;
+    iss >> value;
+    
+    if (value == "default") {
+      computerDelayMs = -1;
+      out << "Computer move delay reset to the default.\n";
+    } else if (!value.empty()) {
+      try {
+        computerDelayMs = std::max(0, std::stoi(value));
+        out << "Computer move delay set to " << computerDelayMs << " ms.\n";
+      } catch (...) {
+        out << "Invalid delay. Use 'delay <milliseconds>' or 'delay default'.\n";
+      }
+    } else {
+      out << "Computer move delay: " << computerMoveDelay() << " ms.\n";
+    }
+    return true;
+  } else if (command == "ponder") {
+    std::string mode;
+    iss >> mode;
+    
+    if (mode == "on" && !interactive) {
+      out << "Pondering is not available in server sessions.\n";
+    } else if (mode == "on") {
+      ponderEnabled = true;
+      out << "Pondering enabled.\n";
+    } else if (mode == "off") {
+      ponderEnabled = false;
+      cancelComputerMove();
+      stopPondering();
+      out << "Pondering disabled.\n";
+    } else {
+      out << "Pondering is " << (ponderEnabled ? "on" : "off") << ". Use 'ponder on' or 'ponder off'.\n";
+    }
+    return true;
+  } else if (command == "snapshot") {
+    std::string path;
+    iss >> path;
+    
+    if (path.empty()) {
+      out << "Usage: snapshot <file.png|file.ppm>\n";
+    } else if (!currentBoard()) {
+      out << "No board to snapshot. Start a game or enter setup mode first.\n";
+    } else {
+      RasterRenderer snapshot(cellSize);
+      snapshot.render(*currentBoard());
+      if (snapshot.save(path)) {
+        out << "Board saved to " << path << "\n";
+      } else {
+        out << "Could not write " << path << "\n";
+      }
+    }
+    return true;
+  } else if (command == "record") {
+    std::string directory;
+    std::string format;
+    iss >> directory >> format;
+    
+    if (directory == "off") {
+      if (recorder) {
+        out << "Recording stopped after " << recordFrameCount << " frame(s).\n";
+      }
+      recorder.reset();
+    } else if (directory.empty()) {
+      if (recorder) {
+        out << "Recording to " << recordDirectory << " (" << recordFrameCount << " frame(s) so far).\n";
+      } else {
+        out << "Not recording. Use 'record <dir> [png|ppm]' to start.\n";
+      }
+    } else if (!format.empty() && format != "png" && format != "ppm") {
+      out << "Invalid format. Use 'png' or 'ppm'.\n";
+    } else {
+      recorder = std::make_unique<RasterRenderer>(cellSize);
+      recordDirectory = directory;
+      recordFormat = format.empty() ? "png" : format;
+      recordFrameCount = 0;
+      recordedHash = 0;
+      out << "Recording a frame per position to " << directory << ".\n";
+      renderGraphics();
+    }
+    return true;
+  } else if (command == "bench") {
+    int iterations = 200;
+    std::string value;
+    if (iss >> value) {
+      try {
+        iterations = std::max(1, std::stoi(value));
+      } catch (...) {
+        out << "Invalid iteration count. Use 'bench [iterations]'.\n";
+        return true;
+      }
+    }
+    runEvalBenchmark(iterations);
+    return true;
+  } else if (command == "analyse") {
+    int multiPv = 1;
+    int depth = 3;
+    bool valid = true;
+    std::string option;
+    while (valid && iss >> option) {
+      std::string value;
+      valid = (option == "multipv" || option == "depth") && (iss >> value);
+      if (!valid) break;
+      try {
+        (option == "multipv" ? multiPv : depth) = std::stoi(value);
+      } catch (...) {
+        valid = false;
+      }
+    }
+    
+    if (!valid || multiPv < 1 || depth < 1 || depth > 6) {
+      out << "Usage: analyse [multipv N] [depth D] (depth 1-6, default 'analyse multipv 1 depth 3')\n";
+      return true;
+    }
+    if (!session.hasPosition()) {
+      out << "No position to analyse. Start with 'game human human'.\n";
+      return true;
+    }
+    
+    if (searchJob) {
+      out << "Cannot analyse while the computer is thinking.\n";
+      return true;
+    }
+    
+    startAnalysis(multiPv, depth);
+    return true;
+  } else if (command == "stop") {
+    if (analysisRunning()) {
+      cancelComputerMove();
+      out << "Analysis stopped.\n";
+    } else {
+      out << "No analysis is running.\n";
+    }
+    return true;
+  } else if (command == "stats") {
+    // Searches evaluate on worker threads, each with its own table
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+    PawnHashTable::totals(probes, hits);
+    double hitRate = probes ? static_cast<double>(hits) / probes : 0.0;
+    out << "Pawn hash: " << probes << " probes, "
+              << hits << " hits ("
+              << static_cast<int>(hitRate * 100 + 0.5) << "% hit rate)\n";
+    out << "Ponder: " << ponderHits.load() << " hits, " << ponderMisses.load() << " misses\n";
+    return true;
   } else if (command == "help") {
-    std::cout << "Commands:\n";
-    std::cout << "  game <player1> <player2> [level] - Start a new game\n";
-    std::cout << "    where <player> is 'human' or 'computer'\n";
-    std::cout << "    and [level] is an optional computer level (1-4)\n";
-    std::cout << "    Examples: 'game human human', 'game human computer 2', 'game computer computer 2 4'\n";
-    std::cout << "  move <from> <to> [promotion] - Move a piece (e.g., 'move e2 e4')\n";
-    std::cout << "  castle kingside/queenside - Castle on king or queen side\n";
-    std::cout << "  setup - Enter setup mode to customize the board\n";
-    std::cout << "  resign - Forfeit the game\n";
-    std::cout << "  draw\n";
-    std::cout << "  score - Display current score\n";
-    std::cout << "  help - Show this help message\n";
-    std::cout << "  quit/exit - Exit the game\n";
+    out << "Commands:\n";
+    out << "  game <player1> <player2> [level] - Start a new game\n";
+    out << "    where <player> is 'human' or 'computer'\n";
+    out << "    and [level] is an optional computer level (1-4)\n";
+    out << "    Examples: 'game human human', 'game human computer 2', 'game computer computer 2 4'\n";
+    out << "  move <from> <to> [promotion] - Move a piece (e.g., 'move e2 e4')\n";
+    out << "  castle kingside/queenside - Castle on king or queen side\n";
+    out << "  setup - Enter setup mode to customize the board\n";
+    out << "  resign - Forfeit the game\n";
+    out << "  draw\n";
+    out << "  score - Display current score\n";
+    out << "  book <path>|off - Use a Polyglot opening book for computer moves\n";
+    out << "  tbgen <dir> [material...] - Generate endgame tablebases (default KQK KRK KPK KBNK)\n";
+    out << "  tb <dir>|off - Use endgame tablebases for computer moves\n";
+    out << "  nnue <file> - Load an evaluation network\n";
+    out << "  eval <level> classic|nnue - Choose the evaluation of a computer level\n";
+    out << "  delay <ms>|default - Pause before each computer move\n";
+    out << "  ponder on/off - Let the computer think during the human's turn\n";
+    out << "  analyse [multipv N] [depth D] - Rank the best N moves of the position with their lines\n";
+    out << "  stop - End a running analysis\n";
+    out << "  stats - Show engine cache statistics\n";
+    out << "  bench [iterations] - Time the evaluation kernels on a fixed set of positions\n";
+    out << "  snapshot <file> - Save the board as a PNG (or .ppm) image\n";
+    out << "  record <dir> [png|ppm]|off - Save an image of every position to <dir>\n";
+    out << "  help - Show this help message\n";
+    out << "  quit/exit - Exit the game\n";
   } else if (command == "quit" || command == "exit") {
     return false;
   } else if (command.empty()) {
     // Empty command, just continue
   } else {
-    std::cout << "Unknown command: " << command << "\n";
-    std::cout << "Type 'help' for a list of commands.\n";
+    out << "Unknown command: " << command << "\n";
+    out << "Type 'help' for a list of commands.\n";
   }
   
   return true;
@@ -711,76 +909,74 @@ bool GameController::processSetupCommand(const std::string& cmd) {
     iss >> pieceType >> posStr;
     
     if (pieceType == 0 || posStr.empty()) {
-      std::cout << "Invalid command format. Use '+ [piece] [position]'.\n";
+      out << "Invalid command format. Use '+ [piece] [position]'.\n";
       return true;
     }
     
     Pos pos = parsePos(posStr);
     if (pos.file == -1) {
-      std::cout << "Invalid position.\n";
+      out << "Invalid position.\n";
       return true;
     }
     
     Colour colour = isupper(pieceType) ? Colour::White : Colour::Black;
     
-    board->placePiece(pos, pieceType, colour);
+    setupBoard.placePiece(pos, pieceType, colour);
     
-    if (graphicsActive) {
-      renderGraphics();
-    }
+    renderGraphics();
     
-    board->draw(std::cout);
+    setupBoard.draw(out);
   } 
   else if (command == "-") {
     std::string posStr;
     iss >> posStr;
     
     if (posStr.empty()) {
-      std::cout << "Invalid command format. Use '- [position]'.\n";
+      out << "Invalid command format. Use '- [position]'.\n";
       return true;
     }
     
     Pos pos = parsePos(posStr);
     if (pos.file == -1) {
-      std::cout << "Invalid position.\n";
+      out << "Invalid position.\n";
       return true;
     }
     
-    board->removePiece(pos);
+    setupBoard.removePiece(pos);
     
-    if (graphicsActive) {
-      renderGraphics();
-    }
+    renderGraphics();
     
-    board->draw(std::cout);
+    setupBoard.draw(out);
   } 
   else if (command == "=") {
     std::string colourStr;
     iss >> colourStr;
     
     if (colourStr == "white") {
-      board->setCurrentTurn(Colour::White);
-      std::cout << "Set white to play next.\n";
+      setupBoard.setCurrentTurn(Colour::White);
+      out << "Set white to play next.\n";
     } else if (colourStr == "black") {
-      board->setCurrentTurn(Colour::Black);
-      std::cout << "Set black to play next.\n";
+      setupBoard.setCurrentTurn(Colour::Black);
+      out << "Set black to play next.\n";
     } else {
-      std::cout << "Invalid colour. Use 'white' or 'black'.\n";
+      out << "Invalid colour. Use 'white' or 'black'.\n";
     }
   }
   else if (command == "graphics") {
-    if (graphicsActive) {
-      std::cout << "Closing graphics window...\n";
+    if (!interactive) {
+      out << "Graphics are not available in server sessions.\n";
+    } else if (graphicsActive) {
+      out << "Closing graphics window...\n";
       closeGraphics();
       graphicsActive = false;
     } else {
-      std::cout << "Opening graphics window...\n";
+      out << "Opening graphics window...\n";
       graphicsActive = initGraphics();
       if (graphicsActive) {
-        std::cout << "Graphics initialized successfully!" << std::endl;
+        out << "Graphics initialized successfully!" << std::endl;
         renderGraphics();
       } else {
-        std::cout << "Graphics initialization failed." << std::endl;
+        out << "Graphics initialization failed." << std::endl;
       }
     }
     return true;
@@ -788,154 +984,98 @@ bool GameController::processSetupCommand(const std::string& cmd) {
   else if (command == "done") {
     if (validateBoard()) {
       setupMode = false;
-      std::cout << "Exiting setup mode. Board is valid.\n";
-      gameInProgress = true;
-      gameOver = false;
+      out << "Exiting setup mode. Board is valid.\n";
+      session.start(setupBoard);
       
-      if (!graphicsActive) {
+      if (!graphicsActive && interactive) {
         graphicsActive = initGraphics();
         
         if (graphicsActive) {
-          std::cout << "Graphics initialized successfully!" << std::endl;
+          out << "Graphics initialized successfully!" << std::endl;
         } else {
-          std::cout << "Graphics initialization failed. Running in text-only mode." << std::endl;
+          out << "Graphics initialization failed. Running in text-only mode." << std::endl;
         }
       }
       
-      if (graphicsActive) {
-        renderGraphics();
-      }
-      
-      board->draw(std::cout);
-      
-      int pieceCount = 0;
-      bool hasOnlyKings = true;
+      renderGraphics();
       
-      for (int rank = 0; rank < 8; ++rank) {
-        for (int file = 0; file < 8; ++file) {
-          auto piece = board->pieceAt({file, rank});
-          if (piece) {
-            pieceCount++;
-            char symbol = piece->symbol();
-            if (symbol != 'K' && symbol != 'k') {
-              hasOnlyKings = false;
-            }
-          }
-        }
-      }
+      const Board& board = session.board();
+      board.draw(out);
       
-      if (pieceCount == 2 && hasOnlyKings) {
-        std::cout << "Kings-only position: Stalemate! The game is a draw.\n";
-        incrementDrawScore();
-        gameInProgress = false;
-        gameOver = true;
+      // A position set up already decided ends the game without scoring it
+      Colour currentPlayerColour = board.getCurrentTurn();
+      GameResult result = session.result();
+      if (result == GameResult::Draw) {
+        out << (board.gameStatus() == GameStatus::DrawByRule ? "Insufficient material!" : "Stalemate!")
+            << " The game is a draw.\n";
         
-        if (graphicsActive) {
-          sleep(2);
-          closeGraphics();
-          graphicsActive = false;
-        }
-        return true;
-      }
-      
-      Colour currentPlayerColour = board->getCurrentTurn();
-      if (board->isStalemate(currentPlayerColour)) {
-        std::cout << "Stalemate! The game is a draw.\n";
-        gameInProgress = false;
-        gameOver = true;
+        // Close the window once the user has seen the final position
+        closeGraphicsLater(2000);
+      } else if (result == GameResult::WhiteWins || result == GameResult::BlackWins) {
+        out << (currentPlayerColour == Colour::White ? "Black" : "White") << " wins!\n";
         
-        if (graphicsActive) {
-          sleep(2);
-          closeGraphics();
-          graphicsActive = false;
-        }
-      } else if (board->isInCheck(currentPlayerColour)) {
-        if (board->isCheckmate(currentPlayerColour)) {
-          std::cout << (currentPlayerColour == Colour::White ? "Black" : "White") << " wins!\n";
-          gameInProgress = false;
-          gameOver = true;
-          
-          if (graphicsActive) {
-            sleep(2);
-            closeGraphics();
-            graphicsActive = false;
-          }
-        } else {
-          std::cout << "Check!\n";
-        }
+        // Close the window once the user has seen the final position
+        closeGraphicsLater(2000);
+      } else if (board.gameStatus() == GameStatus::Check) {
+        out << "Check!\n";
       }
       
-      std::cout << "\n" << (currentPlayerColour == Colour::White ? "White" : "Black") << " to play." << std::endl;
+      out << "\n" << (currentPlayerColour == Colour::White ? "White" : "Black") << " to play." << std::endl;
     } else {
-      std::cout << "Invalid board configuration. Cannot exit setup mode.\n";
+      out << "Invalid board configuration. Cannot exit setup mode.\n";
     }
   } 
   else {
-    std::cout << "Unknown setup command. Available commands:\n";
-    std::cout << "+ [piece] [position] - Add a piece (e.g., '+ K e1' for white king, '+ k e8' for black king)\n";
-    std::cout << "- [position] - Remove a piece (e.g., '- e2')\n";
-    std::cout << "= [color] - Set turn (e.g., '= white' or '= black')\n";
-    std::cout << "graphics - Toggle graphics display on/off\n";
-    std::cout << "done - Exit setup mode\n";
+    out << "Unknown setup command. Available commands:\n";
+    out << "+ [piece] [position] - Add a piece (e.g., '+ K e1' for white king, '+ k e8' for black king)\n";
+    out << "- [position] - Remove a piece (e.g., '- e2')\n";
+    out << "= [color] - Set turn (e.g., '= white' or '= black')\n";
+    out << "graphics - Toggle graphics display on/off\n";
+    out << "done - Exit setup mode\n";
   }
   
   return true;
 }
 
 bool GameController::validateBoard() const {
-  bool whiteKingFound = false;
-  bool blackKingFound = false;
-  int pieceCount = 0;
-  
-  for (int rank = 0; rank < 8; ++rank) {
-    for (int file = 0; file < 8; ++file) {
-      auto piece = board->pieceAt({file, rank});
-      if (piece) {
-        pieceCount++;
-        char symbol = piece->symbol();
-        if (symbol == 'K') {
-          whiteKingFound = true;
-        } else if (symbol == 'k') {
-          blackKingFound = true;
-        }
-      }
-    }
-  }
+  bool whiteKingFound = setupBoard.pieceCount(Colour::White, PieceType::King) > 0;
+  bool blackKingFound = setupBoard.pieceCount(Colour::Black, PieceType::King) > 0;
+  int pieceCount = std::popcount(setupBoard.occupied(Colour::White) | setupBoard.occupied(Colour::Black));
   
   if (!whiteKingFound) {
-    std::cout << "Invalid board: No white king found.\n";
+    out << "Invalid board: No white king found.\n";
     return false;
   }
   
   if (!blackKingFound) {
-    std::cout << "Invalid board: No black king found.\n";
+    out << "Invalid board: No black king found.\n";
     return false;
   }
   
   for (int file = 0; file < 8; ++file) {
-    auto piece1 = board->pieceAt({file, 0});
-    auto piece2 = board->pieceAt({file, 7});
+    auto piece1 = setupBoard.pieceAt({file, 0});
+    auto piece2 = setupBoard.pieceAt({file, 7});
     
     if ((piece1 && (piece1->symbol() == 'P' || piece1->symbol() == 'p')) || 
         (piece2 && (piece2->symbol() == 'P' || piece2->symbol() == 'p'))) {
-      std::cout << "Invalid board: Pawn on the first or last rank.\n";
+      out << "Invalid board: Pawn on the first or last rank.\n";
       return false;
     }
   }
   
-  if (board->isInCheck(Colour::White)) {
-    std::cout << "Invalid board: White king is in check.\n";
+  if (setupBoard.isInCheck(Colour::White)) {
+    out << "Invalid board: White king is in check.\n";
     return false;
   }
   
-  if (board->isInCheck(Colour::Black)) {
-    std::cout << "Invalid board: Black king is in check.\n";
+  if (setupBoard.isInCheck(Colour::Black)) {
+    out << "Invalid board: Black king is in check.\n";
     return false;
   }
   
   if (pieceCount == 2 && whiteKingFound && blackKingFound) {
-    std::cout << "Warning: Board has only two kings. This is an immediate stalemate (draw).\n";
-    std::cout << "The game will end in a draw after setup is completed.\n";
+    out << "Warning: Board has only two kings. This is an immediate stalemate (draw).\n";
+    out << "The game will end in a draw after setup is completed.\n";
   }
   
   return true;
@@ -943,86 +1083,51 @@ bool GameController::validateBoard() const {
 
 void GameController::run() {
   std::string line;
+  
+  // The search thread writes a byte here to wake the main loop's poll()
+  if (wakePipe[0] < 0 && pipe(wakePipe) == 0) {
+    fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+  }
 
-  std::cout << "Chess Game\n";
-  std::cout << "Enter commands:\n";
-  std::cout << "  - game human human - Start a game between two humans\n";
-  std::cout << "  - game human computer [level] - Start a game against the computer\n";
-  std::cout << "  - game computer human [level] - Let the computer play as white\n";
-  std::cout << "  - game computer computer [level] - Watch two computer players\n";
-  std::cout << "  - move <from> <to> [promotion] (e.g., 'move e2 e4')\n";
-  std::cout << "  - setup (enter setup mode)\n";
-  std::cout << "  - resign - Forfeit the game\n";
-  std::cout << "  - draw\n";
-  std::cout << "  - score - Display current score\n";
-  std::cout << "  - quit or exit - Quit the game\n";
+  out << "Chess Game\n";
+  out << "Enter commands:\n";
+  out << "  - game human human - Start a game between two humans\n";
+  out << "  - game human computer [level] - Start a game against the computer\n";
+  out << "  - game computer human [level] - Let the computer play as white\n";
+  out << "  - game computer computer [level] - Watch two computer players\n";
+  out << "  - move <from> <to> [promotion] (e.g., 'move e2 e4')\n";
+  out << "  - setup (enter setup mode)\n";
+  out << "  - resign - Forfeit the game\n";
+  out << "  - draw\n";
+  out << "  - score - Display current score\n";
+  out << "  - quit or exit - Quit the game\n";
   
   bool running = true;
   
   // Print the first prompt
-  std::cout << "Enter command: " << std::flush;
+  out << "Enter command: " << std::flush;
   
   while (running) {
-    // If it's a computer's turn, make its move
-    if (gameInProgress && !gameOver && isComputerTurn()) {
-      // Add a small delay between computer moves for better visibility
-      if (whitePlayerType == PlayerType::Computer && blackPlayerType == PlayerType::Computer) {
-        sleep(2); // 2 second delay in computer vs. computer games
-      } else {
-        // Add a delay for single computer player moves too
-        sleep(1); // 1 second delay for computer vs. human games
-      }
-      makeComputerMove();
-      
-      // In computer vs. computer games, continue until game is over or user interrupts
-      if (gameInProgress && whitePlayerType == PlayerType::Computer && blackPlayerType == PlayerType::Computer) {
-        // Check for user input without blocking
-        struct pollfd fds[1];
-        fds[0].fd = STDIN_FILENO;
-        fds[0].events = POLLIN;
-        
-        if (poll(fds, 1, 0) > 0) {
-          // User input available, break out of computer vs. computer loop
-          if (!std::getline(std::cin, line)) {
-            break; // End of input
-          }
-          
-          if (!processCommand(line)) {
-            running = false;
-          }
-          
-          // Print prompt for next command if still running
-          if (running) {
-            std::cout << "Enter command: " << std::flush;
-          }
-          continue;
-        }
-        
-        // Continue with computer moves
-        continue;
-      }
+    // Handle events Xlib has already queued; poll() only sees new ones
+    if (graphicsActive && !processGraphicsEvents()) {
+      // Window was closed
+      graphicsActive = false;
+      out << "Graphics window closed. Running in text-only mode.\n";
     }
     
-    // Check for graphics events if active
-    if (graphicsActive) {
-      // Process any pending graphics events
-      if (!processGraphicsEvents()) {
-        // Window was closed
-        graphicsActive = false;
-        std::cout << "Graphics window closed. Running in text-only mode.\n";
-      }
+    // Schedule the computer's move once it is its turn
+    bool computerToMove = session.inProgress() && session.isComputerTurn() && !searchJob;
+    if (computerToMove && !computerMoveScheduled) {
+      computerMoveScheduled = true;
+      computerMoveDue = std::chrono::steady_clock::now() + std::chrono::milliseconds(computerMoveDelay());
+    } else if (!computerToMove) {
+      computerMoveScheduled = false;
     }
     
-    struct pollfd fds[1];
-    fds[0].fd = STDIN_FILENO;
-    fds[0].events = POLLIN;
-    
-    if (poll(fds, 1, 10) > 0) {
-      if (!std::getline(std::cin, line)) {
-        running = false;
-        break;
-      }
-      
+    // Input is read throughout, but moves wait while the computer's move is
+    // due or being searched (see nextLineReady)
+    // Complete lines already read are handled before waiting again
+    if (nextLineReady() && takeInputLine(line)) {
       bool shouldContinue = true;
       if (setupMode) {
         shouldContinue = processSetupCommand(line);
@@ -1034,13 +1139,84 @@ void GameController::run() {
         running = false;
       }
       
-      // Print prompt for next command if still running
-      if (running) {
-        std::cout << "Enter command: " << std::flush;
+      // Print prompt for next command if still running; an analysis
+      // prints it after its lines
+      if (running && !analysisRunning()) {
+        out << "Enter command: " << std::flush;
       }
+      continue;
+    }
+    
+    // At the end of input the computer's move or the analysis still finishes
+    if (inputClosed && !computerMoveScheduled && !searchJob) {
+      break; // End of input
+    }
+    
+    // Sleep until input arrives, the X server sends events, a computer move
+    // or the closing of the window becomes due, or the search hands back its
+    // move
+    int timeout = -1;
+    auto waitUntil = [&timeout](std::chrono::steady_clock::time_point due) {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          due - std::chrono::steady_clock::now());
+      int ms = std::max(0, static_cast<int>(remaining.count()));
+      timeout = (timeout < 0) ? ms : std::min(timeout, ms);
+    };
+    if (computerMoveScheduled) {
+      waitUntil(computerMoveDue);
+    }
+    if (graphicsCloseScheduled) {
+      waitUntil(graphicsCloseDue);
+    }
+    
+    struct pollfd fds[3];
+    int fdCount = 0;
+    fds[fdCount].fd = wakePipe[0];
+    fds[fdCount].events = POLLIN;
+    fds[fdCount].revents = 0;
+    ++fdCount;
+    int stdinIndex = -1;
+    if (!inputClosed) {
+      stdinIndex = fdCount;
+      fds[fdCount].fd = STDIN_FILENO;
+      fds[fdCount].events = POLLIN;
+      fds[fdCount].revents = 0;
+      ++fdCount;
+    }
+    if (graphicsActive) {
+      fds[fdCount].fd = ConnectionNumber(graphics->display());
+      fds[fdCount].events = POLLIN;
+      fds[fdCount].revents = 0;
+      ++fdCount;
+    }
+    
+    int ready = poll(fds, fdCount, timeout);
+    if (ready < 0 && errno != EINTR) {
+      break;
+    }
+    
+    if (ready > 0 && (fds[0].revents & POLLIN)) {
+      collectComputerMove();
+    }
+    
+    if (ready > 0 && stdinIndex >= 0 && (fds[stdinIndex].revents & (POLLIN | POLLHUP | POLLERR))) {
+      readInput();
+      continue;
+    }
+    
+    if (graphicsCloseScheduled && std::chrono::steady_clock::now() >= graphicsCloseDue) {
+      closeGraphics();
+      graphicsActive = false;
+    }
+    
+    if (computerMoveScheduled && std::chrono::steady_clock::now() >= computerMoveDue) {
+      computerMoveScheduled = false;
+      startComputerMove();
     }
   }
   
+  cancelComputerMove();
+  
   // Close any open graphics window before exiting
   if (graphicsActive) {
     closeGraphics();
@@ -1049,455 +1225,572 @@ void GameController::run() {
   printFinalScore();
 }
 
-void GameController::incrementScore(Colour winner) {
-    if (winner == Colour::White) {
-        whiteScore += 1.0;
-    } else if (winner == Colour::Black) {
-        blackScore += 1.0;
-    }
+// Server sessions have no terminal or window and no per-game threads: the
+// searches run on the executor and computer moves are played as soon as
+// they are found, ignoring the move delay
+void GameController::startSession(SearchExecutor executor, std::function<void()> notify) {
+  interactive = false;
+  searchExecutor = std::move(executor);
+  searchNotify = std::move(notify);
+  out << "Chess Game\n";
+  out << "Enter command: " << std::flush;
 }
 
-void GameController::incrementDrawScore() {
-    whiteScore += 0.5;
-    blackScore += 0.5;
+bool GameController::handleLine(const std::string& line) {
+  if (quitAfterAnalysis) return true;  // the client is gone once the lines are sent
+  bool shouldContinue = setupMode ? processSetupCommand(line) : processCommand(line);
+  if (!shouldContinue) return false;
+  
+  if (!analysisRunning()) {
+    out << "Enter command: " << std::flush;
+  }
+  if (session.inProgress() && session.isComputerTurn() && !searchJob) {
+    startComputerMove();
+  }
+  return true;
 }
 
-void GameController::printScore() const {
-    std::cout << "Score:" << std::endl;
-    std::cout << "White: " << whiteScore << std::endl;
-    std::cout << "Black: " << blackScore << std::endl;
+bool GameController::handleSearchResult() {
+  collectComputerMove();
+  if (quitAfterAnalysis && !analysisRunning()) return false;
+  
+  // In computer vs. computer games the next search starts right away
+  if (session.inProgress() && session.isComputerTurn() && !searchJob) {
+    startComputerMove();
+  }
+  return true;
 }
 
-void GameController::printFinalScore() const {
-    std::cout << "Final Score:" << std::endl;
-    std::cout << "White: " << whiteScore << std::endl;
-    std::cout << "Black: " << blackScore << std::endl;
-} 
-
-// Check if it's a computer's turn
-bool GameController::isComputerTurn() const {
-  if (!board || !gameInProgress) return false;
-  
-  Colour currentTurn = board->getCurrentTurn();
-  return (currentTurn == Colour::White && whitePlayerType == PlayerType::Computer) ||
-         (currentTurn == Colour::Black && blackPlayerType == PlayerType::Computer);
+void GameController::endSession() {
+  cancelComputerMove();
+  printFinalScore();
 }
 
-// Make a computer move based on the current difficulty level
-void GameController::makeComputerMove() {
-  if (!board || !gameInProgress) return;
-  
-  Colour currentTurn = board->getCurrentTurn();
-  ComputerLevel level = (currentTurn == Colour::White) ? whiteComputerLevel : blackComputerLevel;
-  
-  // Get all legal moves for the current player
-  std::vector<Move> legalMoves = getAllLegalMoves(currentTurn);
+// Read whatever is available on stdin into the input buffer. Only called once
+// poll() reports the descriptor ready (or by readLine), so it does not stall.
+bool GameController::readInput() {
+  char chunk[4096];
+  ssize_t count = read(STDIN_FILENO, chunk, sizeof(chunk));
   
-  if (legalMoves.empty()) {
-    // No legal moves available - should be checkmate or stalemate
-    return;
+  if (count < 0 && errno == EINTR) {
+    return true;
   }
-  
-  // Choose a move based on the difficulty level
-  Move chosenMove = getRandomMove(legalMoves); // Default to random (Level 1)
-  
-  switch (level) {
-    case ComputerLevel::Level1:
-      // Level 1: Random legal moves (already set as default)
-      break;
-      
-    case ComputerLevel::Level2:
-      // Level 2: Prefers capturing moves and checks
-      chosenMove = getBestMoveLevel2(legalMoves);
-      break;
-      
-    case ComputerLevel::Level3:
-      // Level 3: Prefers avoiding capture, capturing moves, and checks
-      chosenMove = getBestMoveLevel3(legalMoves);
-      break;
-      
-    case ComputerLevel::Level4:
-      // Level 4: More sophisticated strategy with piece values and position evaluation
-      chosenMove = getBestMoveLevel4(legalMoves);
-      break;
+  if (count <= 0) {
+    inputClosed = true;
+    return false;
   }
   
-  // Make the chosen move
-  bool moveSuccess = false;
-  if (chosenMove.promotion != '\0') {
-    moveSuccess = board->move(chosenMove.from, chosenMove.to, chosenMove.promotion);
-  } else {
-    moveSuccess = board->move(chosenMove.from, chosenMove.to);
+  inputBuffer.append(chunk, count);
+  return true;
+}
+
+// Take the next complete line from the input buffer. At end of input a final
+// line without a newline is returned as well.
+bool GameController::takeInputLine(std::string& line) {
+  size_t newline = inputBuffer.find('\n');
+  
+  if (newline == std::string::npos) {
+    if (inputClosed && !inputBuffer.empty()) {
+      line = inputBuffer;
+      inputBuffer.clear();
+      return true;
+    }
+    return false;
   }
   
-  if (moveSuccess) {
-    char fromFile = 'a' + chosenMove.from.file;
-    char fromRank = '1' + chosenMove.from.rank;
-    char toFile = 'a' + chosenMove.to.file;
-    char toRank = '1' + chosenMove.to.rank;
-    
-    std::cout << "Computer moves: " << fromFile << fromRank << " to " << toFile << toRank;
-    if (chosenMove.promotion != '\0') {
-      std::cout << " (promotion to " << chosenMove.promotion << ")";
-    }
-    std::cout << std::endl;
-    
-    if (graphicsActive) {
-      renderGraphics();
-    }
-    
-    board->draw(std::cout);
-    
-    Colour nextPlayer = board->getCurrentTurn();
-    std::cout << "\n" << (nextPlayer == Colour::White ? "White" : "Black") << " to play." << std::endl;
-    
-    // Check for check/checkmate/stalemate
-    if (board->isInCheck(nextPlayer)) {
-      if (board->isCheckmate(nextPlayer)) {
-        Colour winner = (nextPlayer == Colour::White) ? Colour::Black : Colour::White;
-        std::cout << "Checkmate! " << (winner == Colour::White ? "White" : "Black") << " wins!" << std::endl;
-        incrementScore(winner);
-        gameInProgress = false;
-        gameOver = true;
-        
-        // Close graphics window
-        if (graphicsActive) {
-          sleep(2); // Give user a moment to see the final position
-          closeGraphics();
-          graphicsActive = false;
-        }
-      } else {
-        std::cout << "Check!" << std::endl;
-      }
-    } else if (board->isStalemate(nextPlayer)) {
-      std::cout << "Stalemate! The game is a draw." << std::endl;
-      incrementDrawScore();
-      gameInProgress = false;
-      gameOver = true;
-      
-      // Close graphics window
-      if (graphicsActive) {
-        sleep(2); // Give user a moment to see the final position
-        closeGraphics();
-        graphicsActive = false;
-      }
+  line = inputBuffer.substr(0, newline);
+  inputBuffer.erase(0, newline + 1);
+  return true;
+}
+
+// Blocking line read for prompts issued in the middle of a command
+bool GameController::readLine(std::string& line) {
+  while (!takeInputLine(line)) {
+    if (inputClosed || !readInput()) {
+      return takeInputLine(line);
     }
   }
+  return true;
 }
 
-// Get all legal moves for a given color
-std::vector<Move> GameController::getAllLegalMoves(Colour colour) const {
-  std::vector<Move> legalMoves;
-  
-  if (!board) return legalMoves;
-  
-  // Check all pieces of the given color
-  for (int srcRank = 0; srcRank < 8; ++srcRank) {
-    for (int srcFile = 0; srcFile < 8; ++srcFile) {
-      Pos src{srcFile, srcRank};
-      auto piece = board->pieceAt(src);
-      
-      // Skip if no piece or not the player's piece
-      if (!piece || piece->colour() != colour) {
-        continue;
+// Milliseconds to wait before a computer move. By default computer vs.
+// computer games pause 2 seconds and games against a human 1 second.
+int GameController::computerMoveDelay() const {
+  if (computerDelayMs >= 0) {
+    return computerDelayMs;
+  }
+  if (session.playerType(Colour::White) == PlayerType::Computer &&
+      session.playerType(Colour::Black) == PlayerType::Computer) {
+    return 2000;
+  }
+  return 1000;
+}
+
+// The board being shown: the one under construction in setup mode, else
+// the game's (null before the first game)
+const Board* GameController::currentBoard() const {
+    if (setupMode) return &setupBoard;
+    return session.hasPosition() ? &session.board() : nullptr;
+}
+
+void GameController::printScore() const {
+    out << "Score:" << std::endl;
+    out << "White: " << session.score(Colour::White) << std::endl;
+    out << "Black: " << session.score(Colour::Black) << std::endl;
+}
+
+void GameController::printFinalScore() const {
+    out << "Final Score:" << std::endl;
+    out << "White: " << session.score(Colour::White) << std::endl;
+    out << "Black: " << session.score(Colour::Black) << std::endl;
+} 
+
+// Search the computer's move on a worker thread, on a copy of the session.
+// The move comes back in searchJob and is played by collectComputerMove
+// once the main loop is woken.
+void GameController::startComputerMove() {
+  if (!session.inProgress() || searchJob) return;
+  
+  computerMoveScheduled = false;
+  auto snapshot = std::make_shared<GameSession>(session);
+  snapshot->seed(rng());
+  // Server sessions already keep every core busy with their own searches,
+  // and never ponder
+  bool parallel = interactive;
+  bool pondering = !searchExecutor;
+  
+  auto job = std::make_shared<SearchJob>();
+  job->key = snapshot->board().hash();
+  searchJob = job;
+  
+  // Only a terminal game's job (pondering) touches the controller, which
+  // then waits for it before going away
+  std::function<void()> notify = jobNotifier();
+  submitJob([this, snapshot, job, parallel, pondering, notify]() {
+    if (!job->stop) {
+      const Board& position = snapshot->board();
+      // If the human played the predicted move the ponder search is the answer
+      Move ponderMove({0, 0}, {0, 0});
+      SearchLimits limits(snapshot->computerLevel(position.getCurrentTurn()));
+      limits.stop = &job->stop;
+      limits.parallel = parallel;
+      if (pondering && finishPondering(job->key, ponderMove)) {
+        limits.hint = &ponderMove;
       }
+      Move move({0, 0}, {0, 0});
+      MoveSource source = MoveSource::Search;
+      bool found = snapshot->bestMove(limits, move, source);
       
-      // Get all legal moves for this piece
-      auto pieceMoves = piece->legalMoves(*board, src);
+      std::lock_guard<std::mutex> lock(job->mutex);
+      job->found = found;
+      job->move = move;
+      job->source = source;
+    }
+    finishJob(*job, notify);
+  });
+}
+
+// Analyse the position on a copy of the session, like a computer move; the
+// lines are printed by collectComputerMove. 'stop' cancels the job.
+void GameController::startAnalysis(int multiPv, int depth) {
+  if (searchJob) return;
+  
+  auto snapshot = std::make_shared<GameSession>(session);
+  auto job = std::make_shared<SearchJob>();
+  job->key = snapshot->board().hash();
+  job->analysis = true;
+  job->depth = depth;
+  searchJob = job;
+  
+  std::function<void()> notify = jobNotifier();
+  submitJob([snapshot, job, multiPv, depth, notify]() {
+    if (!job->stop) {
+      std::vector<AnalysisLine> lines = snapshot->analyse(multiPv, depth, &job->stop);
       
-      // Check if each move is legal (doesn't leave the king in check)
-      for (const auto& dst : pieceMoves) {
-        if (board->simulateMove(src, dst, colour)) {
-          // Check for pawn promotion
-          if ((piece->symbol() == 'P' || piece->symbol() == 'p') && 
-              ((colour == Colour::White && dst.rank == 7) || 
-               (colour == Colour::Black && dst.rank == 0))) {
-            // Add promotion options (Q, R, B, N)
-            legalMoves.push_back(Move(src, dst, 'Q'));
-            legalMoves.push_back(Move(src, dst, 'R'));
-            legalMoves.push_back(Move(src, dst, 'B'));
-            legalMoves.push_back(Move(src, dst, 'N'));
-          } else {
-            legalMoves.push_back(Move(src, dst));
-          }
-        }
-      }
+      std::lock_guard<std::mutex> lock(job->mutex);
+      job->lines = std::move(lines);
+    }
+    finishJob(*job, notify);
+  });
+}
+
+// How a finished job wakes its owner: the session's callback, or a byte on
+// the wake pipe for the terminal loop
+std::function<void()> GameController::jobNotifier() const {
+  if (searchNotify) return searchNotify;
+  
+  int wakeFd = wakePipe[1];
+  return [wakeFd]() {
+    char wake = 1;
+    if (write(wakeFd, &wake, 1) < 0) {
+      // The main loop also checks the job whenever it wakes up
     }
+  };
+}
+
+void GameController::submitJob(std::function<void()> job) {
+  if (searchExecutor) {
+    searchExecutor(std::move(job));
+  } else {
+    backgroundWorkers().submit(std::move(job));
   }
-  
-  return legalMoves;
 }
 
-// Get a random move from the list of legal moves
-Move GameController::getRandomMove(const std::vector<Move>& moves) const {
-  if (moves.empty()) {
-    return Move({0, 0}, {0, 0});
+// Mark the job's results final and wake the owner unless it gave up on them
+void GameController::finishJob(SearchJob& job, const std::function<void()>& notify) {
+  {
+    std::lock_guard<std::mutex> lock(job.mutex);
+    job.done = true;
+    job.finished.notify_all();
   }
-  
-  std::uniform_int_distribution<size_t> dist(0, moves.size() - 1);
-  return moves[dist(rng)];
+  if (!job.stop) {
+    notify();
+  }
+}
+
+bool GameController::analysisRunning() const {
+  return searchJob && searchJob->analysis;
+}
+
+// Whether the next complete input line may run now. While the computer's
+// move is due or being searched, move and castle lines wait for it, so piped
+// moves answer the position they were written for; draw, score, resign and
+// the other commands run at once. During an analysis only 'stop' is read,
+// so a queued quit still prints the lines first.
+bool GameController::nextLineReady() const {
+  size_t newline = inputBuffer.find('\n');
+  if (newline == std::string::npos && !(inputClosed && !inputBuffer.empty())) return false;
+  
+  std::istringstream iss(inputBuffer.substr(0, newline));
+  std::string command;
+  iss >> command;
+  if (analysisRunning()) {
+    return command == "stop";
+  }
+  if (computerMoveScheduled || searchJob) {
+    return setupMode || (command != "move" && command != "castle");
+  }
+  return true;
 }
 
-// Level 2: Prefers capturing moves and checks
-Move GameController::getBestMoveLevel2(const std::vector<Move>& moves) const {
-  if (moves.empty()) {
-    return Move({0, 0}, {0, 0});
+void GameController::printAnalysis(int depth, const std::vector<AnalysisLine>& lines) {
+  if (lines.empty()) {
+    out << "No legal moves in this position.\n";
+    return;
   }
   
-  // Categorize moves
-  std::vector<Move> capturingMoves;
-  std::vector<Move> checkingMoves;
-  std::vector<Move> normalMoves;
+  // Coordinate notation, e.g. e2e4 or e7e8q
+  auto moveText = [](const Move& move) {
+    std::string text;
+    text += static_cast<char>('a' + move.from.file);
+    text += static_cast<char>('1' + move.from.rank);
+    text += static_cast<char>('a' + move.to.file);
+    text += static_cast<char>('1' + move.to.rank);
+    if (move.promotion != '\0') {
+      text += static_cast<char>(tolower(move.promotion));
+    }
+    return text;
+  };
   
-  for (const auto& move : moves) {
-    if (isCapturingMove(move)) {
-      capturingMoves.push_back(move);
-    } else if (isCheckingMove(move)) {
-      checkingMoves.push_back(move);
+  out << "Analysis to depth " << depth << ", scores for "
+      << (session.board().getCurrentTurn() == Colour::White ? "White" : "Black") << ":\n";
+  for (size_t i = 0; i < lines.size(); ++i) {
+    char scoreText[16];
+    if (lines[i].mate != 0) {
+      snprintf(scoreText, sizeof scoreText, "mate %d", lines[i].mate);
     } else {
-      normalMoves.push_back(move);
+      snprintf(scoreText, sizeof scoreText, "%+.2f", lines[i].score / 100.0);
     }
+    out << "  " << (i + 1) << ". " << moveText(lines[i].move) << " " << scoreText << " pv";
+    for (const Move& move : lines[i].pv) {
+      out << " " << moveText(move);
+    }
+    out << "\n";
   }
-  
-  if (!capturingMoves.empty()) {
-    return getRandomMove(capturingMoves);
-  }
-  
-  if (!checkingMoves.empty()) {
-    return getRandomMove(checkingMoves);
+}
+
+// Two threads, so a search can wait for the ponder search it follows
+ThreadPool& GameController::backgroundWorkers() {
+  if (!workers) {
+    workers = std::make_unique<ThreadPool>(2);
   }
-  
-  return getRandomMove(normalMoves);
+  return *workers;
 }
 
-// Level 3: Prefers avoiding capture, capturing moves, and checks
-Move GameController::getBestMoveLevel3(const std::vector<Move>& moves) const {
-  if (moves.empty()) {
-    return Move({0, 0}, {0, 0});
+// Abandon the search in flight; its result, if any, is discarded. A
+// terminal game waits for the job, which may be collecting a ponder search;
+// a session only flags it, so closing a session never waits for the AI pool.
+void GameController::cancelComputerMove() {
+  computerMoveScheduled = false;
+  if (!searchJob) return;
+  
+  std::shared_ptr<SearchJob> job = std::move(searchJob);
+  job->stop = true;
+  if (!searchExecutor) {
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job]() { return job->done; });
   }
   
-  // Categorize moves with priorities
-  std::vector<Move> safeCaptureCheckMoves; // Highest priority: safe moves that capture and check
-  std::vector<Move> safeCaptureMoves;      // High priority: safe moves that capture
-  std::vector<Move> safeCheckMoves;        // Medium-high priority: safe moves that check
-  std::vector<Move> safeMoves;             // Medium priority: moves that don't put the piece in danger
-  std::vector<Move> capturingMoves;        // Medium-low priority: capturing moves (even if unsafe)
-  std::vector<Move> checkingMoves;         // Low priority: checking moves (even if unsafe)
-  std::vector<Move> normalMoves;           // Lowest priority: all other moves
-  
-  for (const auto& move : moves) {
-    bool isCapture = isCapturingMove(move);
-    bool isCheck = isCheckingMove(move);
-    bool isDangerous = movePutsInDanger(move);
-    
-    if (!isDangerous && isCapture && isCheck) {
-      safeCaptureCheckMoves.push_back(move);
-    } else if (!isDangerous && isCapture) {
-      safeCaptureMoves.push_back(move);
-    } else if (!isDangerous && isCheck) {
-      safeCheckMoves.push_back(move);
-    } else if (!isDangerous) {
-      safeMoves.push_back(move);
-    } else if (isCapture) {
-      capturingMoves.push_back(move);
-    } else if (isCheck) {
-      checkingMoves.push_back(move);
-    } else {
-      normalMoves.push_back(move);
-    }
+  char drain[64];
+  while (wakePipe[0] >= 0 && read(wakePipe[0], drain, sizeof(drain)) > 0) {
   }
-  
-  if (!safeCaptureCheckMoves.empty()) return getRandomMove(safeCaptureCheckMoves);
-  if (!safeCaptureMoves.empty()) return getRandomMove(safeCaptureMoves);
-  if (!safeCheckMoves.empty()) return getRandomMove(safeCheckMoves);
-  if (!safeMoves.empty()) return getRandomMove(safeMoves);
-  if (!capturingMoves.empty()) return getRandomMove(capturingMoves);
-  if (!checkingMoves.empty()) return getRandomMove(checkingMoves);
-  
-  return getRandomMove(normalMoves);
 }
 
-// Level 4
-Move GameController::getBestMoveLevel4(const std::vector<Move>& moves) const {
-  if (moves.empty()) {
-    return Move({0, 0}, {0, 0});
+// Called when the main loop is woken: play the searched move if the search
+// is done and still belongs to the current position
+void GameController::collectComputerMove() {
+  char drain[64];
+  while (wakePipe[0] >= 0 && read(wakePipe[0], drain, sizeof(drain)) > 0) {
   }
   
-  Move bestMove = moves[0];
-  int bestScore = -999999; 
-  
-  Colour currentPlayer = board->getCurrentTurn();
+  if (!searchJob) return;
+  std::shared_ptr<SearchJob> job = searchJob;
+  {
+    std::lock_guard<std::mutex> lock(job->mutex);
+    if (!job->done) return;
+  }
+  searchJob.reset();
   
-  for (const auto& move : moves) {
-    // Create a temporary board to simulate the move
-    Board tempBoard = *board;
+  if (job->analysis) {
+    // Input is held during an analysis, so the position is the one analysed
+    printAnalysis(job->depth, job->lines);
+    out << "Enter command: " << std::flush;
+    return;
+  }
+  if (job->found && session.inProgress() && session.board().hash() == job->key) {
+    playComputerMove(job->move, job->source);
+  }
+}
+
+void GameController::playComputerMove(const Move& chosenMove, MoveSource source) {
+  // Make the chosen move
+  if (session.apply(chosenMove)) {
+    char fromFile = 'a' + chosenMove.from.file;
+    char fromRank = '1' + chosenMove.from.rank;
+    char toFile = 'a' + chosenMove.to.file;
+    char toRank = '1' + chosenMove.to.rank;
     
-    bool moveSuccess = false;
-    if (move.promotion != '\0') {
-      moveSuccess = tempBoard.move(move.from, move.to, move.promotion);
-    } else {
-      moveSuccess = tempBoard.move(move.from, move.to);
+    out << "Computer moves: " << fromFile << fromRank << " to " << toFile << toRank;
+    if (chosenMove.promotion != '\0') {
+      out << " (promotion to " << chosenMove.promotion << ")";
+    }
+    if (source == MoveSource::Book) {
+      out << " (book)";
+    } else if (source == MoveSource::Tablebase) {
+      out << " (tablebase)";
     }
+    out << std::endl;
     
-    if (!moveSuccess) continue;
+    renderGraphics();
     
-    int score = evaluatePosition(tempBoard, currentPlayer);
+    const Board& board = session.board();
+    board.draw(out);
     
-    if (score > bestScore) {
-      bestScore = score;
-      bestMove = move;
+    Colour nextPlayer = board.getCurrentTurn();
+    out << "\n" << (nextPlayer == Colour::White ? "White" : "Black") << " to play." << std::endl;
+    
+    // Check for check/checkmate/stalemate; the session has scored the result
+    GameResult result = session.result();
+    if (result == GameResult::WhiteWins || result == GameResult::BlackWins) {
+      out << "Checkmate! " << (result == GameResult::WhiteWins ? "White" : "Black") << " wins!" << std::endl;
+      
+      // Close the window once the user has seen the final position
+      closeGraphicsLater(2000);
+    } else if (result == GameResult::Draw) {
+      out << (session.board().gameStatus() == GameStatus::DrawByRule ? "Insufficient material!" : "Stalemate!")
+          << " The game is a draw." << std::endl;
+      
+      // Close the window once the user has seen the final position
+      closeGraphicsLater(2000);
+    } else if (board.gameStatus() == GameStatus::Check) {
+      out << "Check!" << std::endl;
+    }
+    
+    // Think about the reply while the human considers their move
+    if (session.inProgress() && !session.isComputerTurn()) {
+      startPondering();
     }
   }
-  
-  return bestMove;
 }
 
-// Get the value of a piece
-int GameController::getPieceValue(char pieceSymbol) const {
-  switch (toupper(pieceSymbol)) {
-    case 'P': return 100;   // Pawn
-    case 'N': return 320;   // Knight
-    case 'B': return 330;   // Bishop
-    case 'R': return 500;   // Rook
-    case 'Q': return 900;   // Queen
-    case 'K': return 20000; // King
-    default: return 0;
+// Start searching the computer's reply to the human's most likely move on a
+// background thread. Only level 4 searches; the lower levels answer instantly.
+void GameController::startPondering() {
+  stopPondering();
+  
+  if (!ponderEnabled || !session.inProgress() || session.isComputerTurn()) return;
+  
+  Colour human = session.board().getCurrentTurn();
+  Colour computer = (human == Colour::White) ? Colour::Black : Colour::White;
+  if (session.computerLevel(computer) != ComputerLevel::Level4) return;
+  
+  // Predict the human's move with the same evaluation from their side. Only
+  // the level 4 search is pondered, never the book or tablebases.
+  SearchLimits limits(ComputerLevel::Level4);
+  limits.useBook = false;
+  limits.useTablebase = false;
+  
+  Move predicted({0, 0}, {0, 0});
+  MoveSource source;
+  if (!session.bestMove(limits, predicted, source)) return;
+  
+  auto position = std::make_shared<GameSession>(session);
+  if (!position->apply(predicted)) return;
+  
+  ponderKey = position->board().hash();
+  ponderStop = false;
+  ponderFound = false;
+  limits.stop = &ponderStop;
+  ponderPending = true;
+  {
+    std::lock_guard<std::mutex> lock(ponderMutex);
+    ponderActive = true;
   }
-}
-
-// Evaluate a board position from the perspective of the given color
-int GameController::evaluatePosition(const Board& board, Colour perspective) const {
-  int score = 0;
-  
-  const int pawnPositionBonus[8][8] = {
-    {0,  0,  0,  0,  0,  0,  0,  0},
-    {50, 50, 50, 50, 50, 50, 50, 50},
-    {10, 10, 20, 30, 30, 20, 10, 10},
-    {5,  5, 10, 25, 25, 10,  5,  5},
-    {0,  0,  0, 20, 20,  0,  0,  0},
-    {5, -5,-10,  0,  0,-10, -5,  5},
-    {5, 10, 10,-20,-20, 10, 10,  5},
-    {0,  0,  0,  0,  0,  0,  0,  0}
-  };
-  
-  const int knightPositionBonus[8][8] = {
-    {-50,-40,-30,-30,-30,-30,-40,-50},
-    {-40,-20,  0,  0,  0,  0,-20,-40},
-    {-30,  0, 10, 15, 15, 10,  0,-30},
-    {-30,  5, 15, 20, 20, 15,  5,-30},
-    {-30,  0, 15, 20, 20, 15,  0,-30},
-    {-30,  5, 10, 15, 15, 10,  5,-30},
-    {-40,-20,  0,  5,  5,  0,-20,-40},
-    {-50,-40,-30,-30,-30,-30,-40,-50}
-  };
   
-  const int bishopPositionBonus[8][8] = {
-    {-20,-10,-10,-10,-10,-10,-10,-20},
-    {-10,  0,  0,  0,  0,  0,  0,-10},
-    {-10,  0, 10, 10, 10, 10,  0,-10},
-    {-10,  5,  5, 10, 10,  5,  5,-10},
-    {-10,  0,  5, 10, 10,  5,  0,-10},
-    {-10,  5,  5,  5,  5,  5,  5,-10},
-    {-10,  0,  5,  0,  0,  5,  0,-10},
-    {-20,-10,-10,-10,-10,-10,-10,-20}
-  };
-  
-  for (int rank = 0; rank < 8; ++rank) {
-    for (int file = 0; file < 8; ++file) {
-      Pos pos{file, rank};
-      auto piece = board.pieceAt(pos);
-      
-      if (piece) {
-        int pieceValue = getPieceValue(piece->symbol());
-        int positionBonus = 0;
-        
-        char pieceType = toupper(piece->symbol());
-        if (pieceType == 'P') {
-          positionBonus = pawnPositionBonus[rank][file];
-        } else if (pieceType == 'N') {
-          positionBonus = knightPositionBonus[rank][file];
-        } else if (pieceType == 'B') {
-          positionBonus = bishopPositionBonus[rank][file];
-        }
-        
-        if (piece->colour() == Colour::Black) {
-          positionBonus = pawnPositionBonus[7 - rank][file];
-        }
-        
-        if (piece->colour() == perspective) {
-          score += pieceValue + positionBonus;
-        } else {
-          score -= pieceValue + positionBonus;
-        }
-      }
+  backgroundWorkers().submit([this, position, limits]() {
+    Move best({0, 0}, {0, 0});
+    MoveSource bestSource;
+    if (position->bestMove(limits, best, bestSource) && !ponderStop) {
+      ponderResult = best;
+      ponderFound = true;
     }
+    
+    std::lock_guard<std::mutex> lock(ponderMutex);
+    ponderActive = false;
+    ponderFinished.notify_all();
+  });
+}
+
+void GameController::waitForPonder() {
+  std::unique_lock<std::mutex> lock(ponderMutex);
+  ponderFinished.wait(lock, [this]() { return !ponderActive; });
+}
+
+// Called when the computer has to move. On a ponder hit the background search
+// is allowed to finish and its move is returned; otherwise it is cancelled.
+bool GameController::finishPondering(uint64_t key, Move& move) {
+  if (!ponderPending) return false;
+  ponderPending = false;
+  
+  bool hit = (key == ponderKey);
+  if (!hit) {
+    ponderStop = true;
   }
+  waitForPonder();
   
-  Colour opponent = (perspective == Colour::White) ? Colour::Black : Colour::White;
-  if (board.isInCheck(opponent)) {
-    score += 50;
-  }
-  
-  if (board.isInCheck(perspective)) {
-    score -= 50;
-  }
-  
-  if (board.isCheckmate(opponent)) {
-    score += 10000;
-  }
-  
-  if (board.isCheckmate(perspective)) {
-    score -= 10000;
+  if (hit && ponderFound) {
+    ++ponderHits;
+    move = ponderResult;
+    return true;
   }
   
-  return score;
+  ++ponderMisses;
+  return false;
 }
 
-// Check if a move is a capturing move
-bool GameController::isCapturingMove(const Move& move) const {
-  if (!board) return false;
+void GameController::stopPondering() {
+  if (!ponderPending) return;
+  ponderPending = false;
   
-  auto destPiece = board->pieceAt(move.to);
-  return destPiece != nullptr && destPiece->colour() != board->getCurrentTurn();
+  ponderStop = true;
+  waitForPonder();
 }
 
-// Check if a move puts the opponent in check
-bool GameController::isCheckingMove(const Move& move) const {
-  if (!board) return false;
-  
-  Board tempBoard = *board;
-  
-  bool moveSuccess = false;
-  if (move.promotion != '\0') {
-    moveSuccess = tempBoard.move(move.from, move.to, move.promotion);
-  } else {
-    moveSuccess = tempBoard.move(move.from, move.to);
+// Time every evaluation kernel the CPU supports on the same positions, and
+// the network's when one is loaded. The corpus comes from random games with
+// a fixed seed, so runs are comparable.
+void GameController::runEvalBenchmark(int iterations) const {
+  std::vector<BoardState> corpus;
+  std::mt19937 corpusRng(246);
+  for (int game = 0; game < 100; ++game) {
+    Board position;
+    for (int ply = 0; ply < 60; ++ply) {
+      corpus.push_back(position.snapshot());
+      std::vector<Move> moves;
+      position.legalMoves(position.getCurrentTurn(), MoveGenType::All, moves);
+      if (moves.empty()) break;
+      std::uniform_int_distribution<size_t> dist(0, moves.size() - 1);
+      const Move& move = moves[dist(corpusRng)];
+      if (move.promotion != '\0') {
+        position.move(move.from, move.to, move.promotion);
+      } else {
+        position.move(move.from, move.to);
+      }
+    }
   }
   
-  if (!moveSuccess) return false;
+  out << "Evaluating " << corpus.size() << " positions x " << iterations << " iterations\n";
   
-  // Check if the opponent is in check after the move
-  Colour opponentColour = (board->getCurrentTurn() == Colour::White) ? Colour::Black : Colour::White;
-  return tempBoard.isInCheck(opponentColour);
-}
-
-// Check if a move puts the piece in danger (could be captured in the next move)
-bool GameController::movePutsInDanger(const Move& move) const {
-  if (!board) return false;
+  double scalarTime = 0;
+  long long scalarChecksum = 0;
+  const EvalKernel::Isa kernels[] = {EvalKernel::Isa::Scalar, EvalKernel::Isa::SSE2, EvalKernel::Isa::AVX2};
+  for (EvalKernel::Isa isa : kernels) {
+    if (!EvalKernel::supported(isa)) {
+      out << "  " << EvalKernel::name(isa) << ": not supported by this CPU\n";
+      continue;
+    }
+    
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      for (const BoardState& state : corpus) {
+        checksum += EvalKernel::evaluate(state, isa);
+      }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    double perEval = elapsed.count() / (static_cast<double>(corpus.size()) * iterations);
+    
+    if (isa == EvalKernel::Isa::Scalar) {
+      scalarTime = perEval;
+      scalarChecksum = checksum;
+    }
+    
+    out << "  " << EvalKernel::name(isa) << ": " << perEval << " ns/eval";
+    if (isa != EvalKernel::Isa::Scalar && perEval > 0) {
+      out << " (" << scalarTime / perEval << "x scalar)";
+    }
+    if (checksum != scalarChecksum) {
+      out << " MISMATCH";
+    }
+    out << "\n";
+  }
+  out << "Using " << EvalKernel::name(EvalKernel::best()) << " for evaluation.\n";
   
-  // Create a temporary copy of the board to simulate the move
-  Board tempBoard = *board;
+  std::shared_ptr<const NnueNetwork> nnue = session.getNetwork();
+  if (!nnue) return;
   
-  // Make the move on the temporary board
-  bool moveSuccess = false;
-  if (move.promotion != '\0') {
-    moveSuccess = tempBoard.move(move.from, move.to, move.promotion);
-  } else {
-    moveSuccess = tempBoard.move(move.from, move.to);
+  // The network's dense layers on the same positions, accumulators prepared
+  std::vector<NnueAccumulator> accumulators(corpus.size());
+  for (size_t i = 0; i < corpus.size(); ++i) {
+    nnue->refresh(corpus[i], accumulators[i]);
   }
   
-  if (!moveSuccess) return false;
-  
-  Colour opponentColour = (board->getCurrentTurn() == Colour::White) ? Colour::Black : Colour::White;
-  return tempBoard.isSquareAttacked(move.to, opponentColour);
-} 
+  out << "Network (" << nnue->hiddenSize() << " hidden, " << nnue->denseSize() << " dense units):\n";
+  for (EvalKernel::Isa isa : kernels) {
+    if (!EvalKernel::supported(isa)) continue;
+    
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      for (size_t j = 0; j < corpus.size(); ++j) {
+        checksum += nnue->evaluate(accumulators[j], corpus[j].currentTurn, isa);
+      }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    double perEval = elapsed.count() / (static_cast<double>(corpus.size()) * iterations);
+    
+    if (isa == EvalKernel::Isa::Scalar) {
+      scalarTime = perEval;
+      scalarChecksum = checksum;
+    }
+    
+    out << "  " << EvalKernel::name(isa) << ": " << perEval << " ns/eval";
+    if (isa != EvalKernel::Isa::Scalar && perEval > 0) {
+      out << " (" << scalarTime / perEval << "x scalar)";
+    }
+    if (checksum != scalarChecksum) {
+      out << " MISMATCH";
+    }
+    out << "\n";
+  }
+}
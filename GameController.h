@@ -2,6 +2,7 @@
 #define GAME_CONTROLLER_H
 
 #include "Board.h"
+#include "GameSession.h"
 #include "Pos.h"
 #include "Piece.h"
 #include "King.h"
@@ -10,86 +11,166 @@
 #include "Knight.h"
 #include "Bishop.h"
 #include "Queen.h"
-#include <X11/Xlib.h>
-#include <X11/Xutil.h>
+#include "Move.h"
+#include "X11Renderer.h"
+#include "RasterRenderer.h"
+#include "ThreadPool.h"
 #include <memory>
 #include <string>
 #include <iostream>
 #include <vector>
 #include <random>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <chrono>
 
-class Move;
-
-enum class PlayerType { Human, Computer };
-enum class ComputerLevel { Level1, Level2, Level3, Level4 };
-
-struct Move {
-  Pos from;
-  Pos to;
-  char promotion;
-  Move(Pos f, Pos t, char p = '\0') : from(f), to(t), promotion(p) {}
-};
-
+// Text and X11 front end of a GameSession: parses commands, prints the
+// board and results to out, and runs computer moves in the background.
 class GameController {
 public:
-  GameController();
+  // Runs a search job; the job calls back once its move is ready
+  typedef std::function<void(std::function<void()>)> SearchExecutor;
+
+  explicit GameController(std::ostream& out = std::cout);
   ~GameController();
   void run();
 
+  // Server sessions: commands arrive one line at a time with no terminal or
+  // window, and computer moves are searched by executor. After a search
+  // notify is called (from the search thread); the owner then calls
+  // handleSearchResult. Everything except notify runs under the owner's lock.
+  void startSession(SearchExecutor executor, std::function<void()> notify);
+  bool handleLine(const std::string& line);  // false once the client quits
+  bool handleSearchResult();  // false if the client's quit waited for it
+  void endSession();
+
 private:
-  std::shared_ptr<Board> board;
-  bool gameInProgress;
-  bool gameOver;
+  std::ostream& out;
+  GameSession session;
   bool setupMode;
-  double whiteScore;
-  double blackScore;
-
-  PlayerType whitePlayerType;
-  PlayerType blackPlayerType;
-  ComputerLevel whiteComputerLevel;
-  ComputerLevel blackComputerLevel;
-  mutable std::mt19937 rng;
-
-  Display* display;
-  Window window;
-  GC gc;
+  Board setupBoard;  // the position being edited in setup mode
+  std::mt19937 rng;  // seeds the session copies handed to searches
+
+  // Pondering: search the computer's reply to the predicted human move.
+  // ponderPending until the search is collected or stopped; ponderActive
+  // while it runs, guarded by ponderMutex.
+  bool ponderEnabled;
+  bool ponderPending;
+  std::mutex ponderMutex;
+  std::condition_variable ponderFinished;
+  bool ponderActive;
+  std::atomic<bool> ponderStop;
+  uint64_t ponderKey;  // hash of the position the ponder search is for
+  Move ponderResult;
+  bool ponderFound;
+  std::atomic<uint64_t> ponderHits;  // counted on the search thread, read by stats
+  std::atomic<uint64_t> ponderMisses;
+
+  // Main loop state: buffered stdin and the next scheduled computer move
+  std::string inputBuffer;
+  bool inputClosed;
+  int computerDelayMs;
+  bool computerMoveScheduled;
+  std::chrono::steady_clock::time_point computerMoveDue;
+
+  std::unique_ptr<X11Renderer> graphics;
   int cellSize;
   bool graphicsActive;
+  bool interactive;  // false in server sessions: no window, prompts or pondering
+  bool graphicsCloseScheduled;  // the window closes at graphicsCloseDue
+  std::chrono::steady_clock::time_point graphicsCloseDue;
+
+  // Recording: one image per distinct position, written to recordDirectory
+  std::unique_ptr<RasterRenderer> recorder;
+  std::string recordDirectory;
+  std::string recordFormat;
+  int recordFrameCount;
+  uint64_t recordedHash;
 
-  unsigned long whiteSquareColor;
-  unsigned long blackSquareColor;
-  unsigned long whitePieceColor;
-  unsigned long blackPieceColor;
-  unsigned long textColor;
+  // Mouse input: the selected piece and the legal moves of the position it
+  // was selected in, so highlighting does not regenerate moves per click
+  bool selectionActive;
+  Pos selectedSquare;
+  uint64_t selectionKey;
+  std::vector<Move> legalMoveCache;
+  uint64_t legalMoveCacheKey;
+  bool legalMoveCacheValid;
+
+  // Asynchronous computer move: searched on the background workers (or by
+  // searchExecutor in a session) into a SearchJob that the job shares, then
+  // a byte on wakePipe (or a call to searchNotify) wakes the main loop. A
+  // cancelled job keeps its SearchJob alive and returns early without
+  // touching the controller, so a session can go away while its job is
+  // still queued.
+  struct SearchJob {
+    uint64_t key;  // hash of the position the move is searched for
+    std::atomic<bool> stop{false};
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;  // the fields below are final; guarded by mutex
+    bool found = false;
+    Move move{{0, 0}, {0, 0}};
+    MoveSource source = MoveSource::Search;
+    // An 'analyse' command runs as a job too, so it can be stopped and
+    // never blocks the loop; lines is filled like move
+    bool analysis = false;
+    int depth = 0;
+    std::vector<AnalysisLine> lines;
+  };
+  SearchExecutor searchExecutor;
+  std::function<void()> searchNotify;
+  std::shared_ptr<SearchJob> searchJob;  // the search in flight, if any
+  bool quitAfterAnalysis;  // a session's quit arrived during an analysis
+  int wakePipe[2];
+
+  // Searches and pondering of terminal games. The threads outlive single
+  // moves, so their pawn hash tables stay warm from move to move. Declared
+  // last: destroyed first, once no job can still be touching the members.
+  std::unique_ptr<ThreadPool> workers;
 
   bool initGraphics();
-  void renderGraphics() const;
+  void renderGraphics(bool fullRefresh = false);
   bool processGraphicsEvents();
   void closeGraphics();
-  void drawPieceSprite(int x, int y, char symbol) const;
+  void closeGraphicsLater(int delayMs);
+  void handleBoardClick(int x, int y);
+  void clearSelection();
+  const std::vector<Move>& cachedLegalMoves();
+
+  bool readInput();
+  bool takeInputLine(std::string& line);
+  bool readLine(std::string& line);
+  int computerMoveDelay() const;
 
+  const Board* currentBoard() const;
   void printFinalScore() const;
   void printScore() const;
-  void incrementScore(Colour winner);
-  void incrementDrawScore();
   bool processCommand(const std::string& cmd);
   Pos parsePos(const std::string& pos);
 
   bool processSetupCommand(const std::string& cmd);
   bool validateBoard() const;
 
-  bool isComputerTurn() const;
-  void makeComputerMove();
-  std::vector<Move> getAllLegalMoves(Colour colour) const;
-  Move getRandomMove(const std::vector<Move>& moves) const;
-  Move getBestMoveLevel2(const std::vector<Move>& moves) const;
-  Move getBestMoveLevel3(const std::vector<Move>& moves) const;
-  Move getBestMoveLevel4(const std::vector<Move>& moves) const;
-  bool isCapturingMove(const Move& move) const;
-  bool isCheckingMove(const Move& move) const;
-  bool movePutsInDanger(const Move& move) const;
-  int evaluatePosition(const Board& board, Colour perspective) const;
-  int getPieceValue(char pieceSymbol) const;
+  void startComputerMove();
+  void startAnalysis(int multiPv, int depth);
+  std::function<void()> jobNotifier() const;
+  void submitJob(std::function<void()> job);
+  static void finishJob(SearchJob& job, const std::function<void()>& notify);
+  bool analysisRunning() const;
+  bool nextLineReady() const;
+  void printAnalysis(int depth, const std::vector<AnalysisLine>& lines);
+  void cancelComputerMove();
+  void collectComputerMove();
+  void playComputerMove(const Move& move, MoveSource source);
+  void startPondering();
+  bool finishPondering(uint64_t key, Move& move);
+  void stopPondering();
+  void waitForPonder();
+  ThreadPool& backgroundWorkers();
+  void runEvalBenchmark(int iterations) const;
 };
 
 #endif 
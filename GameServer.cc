@@ -0,0 +1,349 @@
+#include "GameServer.h"
+#include "GameController.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+  // epoll user data of the server's own descriptors; sessions count up from
+  // firstSessionId
+  const uint64_t listenId = 0;
+  const uint64_t readyId = 1;
+  const uint64_t stopId = 2;
+  const uint64_t firstSessionId = 16;
+
+  // A client that sends a line this long, or stops reading this much
+  // output, is disconnected
+  const size_t maxLineLength = 64 * 1024;
+  const size_t maxPendingOutput = 1024 * 1024;
+
+  const int eventsPerWait = 64;
+
+  // Sessions are armed one-shot: after an event is delivered no other I/O
+  // thread sees the session until it is armed again
+  uint32_t sessionEvents(bool pendingOutput) {
+    uint32_t events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    if (pendingOutput) events |= EPOLLOUT;
+    return events;
+  }
+
+  bool addToEpoll(int epollFd, int fd, uint64_t id, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = id;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+  }
+}
+
+GameServer::GameServer(int ioThreads, int aiThreads)
+  : epollFd{epoll_create1(EPOLL_CLOEXEC)},
+    listenFd{-1},
+    readyFd{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)},
+    stopFd{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)},
+    ioThreadCount{std::max(1, ioThreads)},
+    stopping{false},
+    nextSessionId{firstSessionId},
+    aiPool{aiThreads} {
+  addToEpoll(epollFd, readyFd, readyId, EPOLLIN);
+  addToEpoll(epollFd, stopFd, stopId, EPOLLIN);
+}
+
+GameServer::~GameServer() {
+  if (listenFd >= 0) close(listenFd);
+  if (!unixPath.empty()) unlink(unixPath.c_str());
+  close(stopFd);
+  close(readyFd);
+  close(epollFd);
+}
+
+bool GameServer::listen(const std::string& address) {
+  int fd = -1;
+
+  if (address.compare(0, 5, "unix:") == 0) {
+    std::string path = address.substr(5);
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    unlink(path.c_str());  // left behind by an earlier server
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      close(fd);
+      return false;
+    }
+    unixPath = path;
+  } else if (address.compare(0, 4, "tcp:") == 0) {
+    int port = 0;
+    try {
+      port = std::stoi(address.substr(4));
+    } catch (...) {
+      return false;
+    }
+    if (port <= 0 || port > 65535) return false;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      close(fd);
+      return false;
+    }
+  } else {
+    return false;
+  }
+
+  if (::listen(fd, SOMAXCONN) != 0 || !addToEpoll(epollFd, fd, listenId, EPOLLIN)) {
+    close(fd);
+    return false;
+  }
+  listenFd = fd;
+  return true;
+}
+
+void GameServer::run() {
+  std::vector<std::thread> threads;
+  for (int i = 1; i < ioThreadCount; ++i) {
+    threads.emplace_back([this]() { serve(); });
+  }
+  serve();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Say goodbye to whoever is still connected
+  std::unordered_map<uint64_t, std::shared_ptr<Session>> remaining;
+  {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    remaining = sessions;
+  }
+  for (auto& entry : remaining) {
+    std::lock_guard<std::mutex> lock(entry.second->mutex);
+    closeSession(*entry.second);
+  }
+}
+
+void GameServer::stop() {
+  stopping = true;
+  uint64_t one = 1;
+  if (write(stopFd, &one, sizeof(one)) < 0) {
+    // Already signalled
+  }
+}
+
+size_t GameServer::sessionCount() const {
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  return sessions.size();
+}
+
+// One I/O thread. All of them wait on the same epoll instance.
+void GameServer::serve() {
+  epoll_event events[eventsPerWait];
+
+  while (!stopping) {
+    int count = epoll_wait(epollFd, events, eventsPerWait, -1);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+
+    for (int i = 0; i < count && !stopping; ++i) {
+      uint64_t id = events[i].data.u64;
+      if (id == listenId) {
+        acceptClients();
+      } else if (id == readyId) {
+        handleReady();
+      } else if (id == stopId) {
+        stopping = true;
+      } else if (auto session = findSession(id)) {
+        handleEvents(session, events[i].events);
+      }
+    }
+  }
+}
+
+void GameServer::acceptClients() {
+  for (;;) {
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      // EAGAIN once the backlog is empty (or another thread took the client)
+      return;
+    }
+
+    std::shared_ptr<Session> session;
+    {
+      std::lock_guard<std::mutex> lock(sessionsMutex);
+      session = std::make_shared<Session>(nextSessionId++, fd);
+      sessions[session->id] = session;
+    }
+
+    std::lock_guard<std::mutex> lock(session->mutex);
+    uint64_t id = session->id;
+    session->controller.startSession(
+        [this](std::function<void()> job) { aiPool.submit(std::move(job)); },
+        [this, id]() { postReady(id); });
+
+    if (!flush(*session) ||
+        !addToEpoll(epollFd, fd, id, sessionEvents(!session->outbox.empty()))) {
+      closeSession(*session);
+    }
+  }
+}
+
+void GameServer::handleEvents(const std::shared_ptr<Session>& session, uint32_t events) {
+  std::lock_guard<std::mutex> lock(session->mutex);
+  if (session->closed) return;
+
+  bool open = true;
+  if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+    open = readInput(*session);
+  }
+  if (open) {
+    open = flush(*session);
+  }
+
+  if (open) {
+    rearm(*session);
+  } else {
+    closeSession(*session);
+  }
+}
+
+// Called from an AI worker: the session's search has a result
+void GameServer::postReady(uint64_t id) {
+  {
+    std::lock_guard<std::mutex> lock(readyMutex);
+    readySessions.push_back(id);
+  }
+  uint64_t one = 1;
+  if (write(readyFd, &one, sizeof(one)) < 0) {
+    // The counter only saturates if nobody is reading it
+  }
+}
+
+void GameServer::handleReady() {
+  uint64_t count;
+  if (read(readyFd, &count, sizeof(count)) < 0) {
+    // Another I/O thread got there first; the queue tells what is left
+  }
+
+  std::deque<uint64_t> ready;
+  {
+    std::lock_guard<std::mutex> lock(readyMutex);
+    ready.swap(readySessions);
+  }
+
+  for (uint64_t id : ready) {
+    auto session = findSession(id);
+    if (!session) continue;
+
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if (session->closed) continue;
+    if (session->controller.handleSearchResult() && flush(*session)) {
+      rearm(*session);
+    } else {
+      closeSession(*session);
+    }
+  }
+}
+
+// Read what the client sent and run every complete line. False when the
+// client disconnected, quit or misbehaved.
+bool GameServer::readInput(Session& session) {
+  bool open = true;
+  char chunk[4096];
+
+  for (;;) {
+    ssize_t count = read(session.fd, chunk, sizeof(chunk));
+    if (count > 0) {
+      session.input.append(chunk, count);
+      continue;
+    }
+    if (count < 0 && errno == EINTR) continue;
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    open = false;  // end of input or error; still run what was sent
+    break;
+  }
+
+  size_t newline;
+  while ((newline = session.input.find('\n')) != std::string::npos) {
+    std::string line = session.input.substr(0, newline);
+    session.input.erase(0, newline + 1);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+
+    if (!session.controller.handleLine(line)) return false;
+  }
+
+  return open && session.input.size() <= maxLineLength;
+}
+
+// Send as much pending output as the socket takes. False on a write error or
+// a client that has stopped reading.
+bool GameServer::flush(Session& session) {
+  session.outbox += session.output.str();
+  session.output.str("");
+
+  while (!session.outbox.empty()) {
+    ssize_t count = send(session.fd, session.outbox.data(), session.outbox.size(), MSG_NOSIGNAL);
+    if (count > 0) {
+      session.outbox.erase(0, count);
+      continue;
+    }
+    if (count < 0 && errno == EINTR) continue;
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    return false;
+  }
+
+  return session.outbox.size() <= maxPendingOutput;
+}
+
+void GameServer::rearm(Session& session) {
+  epoll_event event{};
+  event.events = sessionEvents(!session.outbox.empty());
+  event.data.u64 = session.id;
+  epoll_ctl(epollFd, EPOLL_CTL_MOD, session.fd, &event);
+}
+
+// Called with the session locked. A search still queued or running for the
+// session is only flagged to stop: the job holds its own state and never
+// touches the controller once cancelled, so the I/O thread does not wait.
+void GameServer::closeSession(Session& session) {
+  if (session.closed) return;
+  session.closed = true;
+
+  session.controller.endSession();
+  flush(session);
+
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, session.fd, nullptr);
+  close(session.fd);
+
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  sessions.erase(session.id);
+}
+
+std::shared_ptr<GameServer::Session> GameServer::findSession(uint64_t id) const {
+  std::lock_guard<std::mutex> lock(sessionsMutex);
+  auto it = sessions.find(id);
+  return (it == sessions.end()) ? nullptr : it->second;
+}
@@ -0,0 +1,82 @@
+#ifndef GAME_SERVER_H
+#define GAME_SERVER_H
+
+#include "GameController.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+// Hosts many independent games in one process. Every connection gets its own
+// GameController and speaks the same line commands as the terminal. Sockets
+// are multiplexed with one epoll instance shared by a few I/O threads (each
+// session is armed one-shot, so only one thread handles it at a time) and
+// computer moves are searched on a separate pool of AI workers.
+class GameServer {
+public:
+  GameServer(int ioThreads, int aiThreads);
+  ~GameServer();
+  GameServer(const GameServer&) = delete;
+  GameServer& operator=(const GameServer&) = delete;
+
+  // "unix:<path>" or "tcp:<port>" (loopback only)
+  bool listen(const std::string& address);
+
+  // Serves until stop() is called, then closes every session
+  void run();
+  // Safe to call from a signal handler
+  void stop();
+
+  size_t sessionCount() const;
+
+private:
+  struct Session {
+    uint64_t id;
+    int fd;
+    std::mutex mutex;
+    std::ostringstream output;  // what the controller printed since the last flush
+    GameController controller;
+    std::string input;
+    std::string outbox;         // output not yet accepted by the socket
+    bool closed;
+
+    Session(uint64_t id, int fd) : id{id}, fd{fd}, controller{output}, closed{false} {}
+  };
+
+  int epollFd;
+  int listenFd;
+  int readyFd;  // eventfd: a search finished, see readySessions
+  int stopFd;   // eventfd: left readable so every I/O thread sees it
+  std::string unixPath;
+  int ioThreadCount;
+  std::atomic<bool> stopping;
+
+  mutable std::mutex sessionsMutex;
+  std::unordered_map<uint64_t, std::shared_ptr<Session>> sessions;
+  uint64_t nextSessionId;
+
+  std::mutex readyMutex;
+  std::deque<uint64_t> readySessions;
+
+  // Declared last so its workers are joined before anything a finishing
+  // job reports to is destroyed
+  ThreadPool aiPool;
+
+  void serve();
+  void acceptClients();
+  void handleEvents(const std::shared_ptr<Session>& session, uint32_t events);
+  void handleReady();
+  void postReady(uint64_t id);
+  bool readInput(Session& session);
+  bool flush(Session& session);
+  void rearm(Session& session);
+  void closeSession(Session& session);
+  std::shared_ptr<Session> findSession(uint64_t id) const;
+};
+
+#endif
@@ -0,0 +1,677 @@
+#include "GameSession.h"
+#include "Board.h"
+#include "Colour.h"
+#include "Piece.h"
+#include "PawnHash.h"
+#include "EvalKernel.h"
+#include "Nnue.h"
+#include "MoveFeatures.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <random>
+
+namespace {
+  // Search scores: a mate found ply plies from the root scores MateScore - ply
+  constexpr int MateScore = 100000;
+  constexpr int InfiniteScore = 1000000;
+  
+  // Analyse every candidate move, spread over the shared work-stealing pool
+  // when parallel. Callers write results into per-move slots.
+  void forEachMove(size_t count, bool parallel, const std::function<void(size_t)>& body) {
+    if (parallel) {
+      WorkStealingPool::shared().parallelFor(count, body);
+    } else {
+      for (size_t i = 0; i < count; ++i) {
+        body(i);
+      }
+    }
+  }
+}
+
+GameSession::GameSession()
+  : state{GameResult::NotStarted},
+    started{false},
+    whiteScore{0.0},
+    blackScore{0.0},
+    whitePlayerType{PlayerType::Human},
+    blackPlayerType{PlayerType::Human},
+    whiteComputerLevel{ComputerLevel::Level1},
+    blackComputerLevel{ComputerLevel::Level1},
+    rng{std::random_device{}()},
+    levelEval{EvalType::Classic, EvalType::Classic, EvalType::Classic, EvalType::Classic} {}
+
+void GameSession::setPlayer(Colour colour, PlayerType type, ComputerLevel level) {
+  if (colour == Colour::White) {
+    whitePlayerType = type;
+    whiteComputerLevel = level;
+  } else {
+    blackPlayerType = type;
+    blackComputerLevel = level;
+  }
+}
+
+PlayerType GameSession::playerType(Colour colour) const {
+  return (colour == Colour::White) ? whitePlayerType : blackPlayerType;
+}
+
+ComputerLevel GameSession::computerLevel(Colour colour) const {
+  return (colour == Colour::White) ? whiteComputerLevel : blackComputerLevel;
+}
+
+void GameSession::start(const Board& position) {
+  current = position;
+  started = true;
+  state = GameResult::InProgress;
+  updateResult(false);
+}
+
+bool GameSession::apply(const Move& move) {
+  if (state != GameResult::InProgress) return false;
+  if (!applyMove(current, move)) return false;
+
+  updateResult(true);
+  return true;
+}
+
+void GameSession::resign(Colour colour) {
+  if (state != GameResult::InProgress) return;
+
+  if (colour == Colour::White) {
+    state = GameResult::BlackWins;
+    blackScore += 1.0;
+  } else {
+    state = GameResult::WhiteWins;
+    whiteScore += 1.0;
+  }
+}
+
+void GameSession::declareDraw() {
+  if (state != GameResult::InProgress) return;
+
+  state = GameResult::Draw;
+  whiteScore += 0.5;
+  blackScore += 0.5;
+}
+
+// End the game if the side to move is mated or stalemated, or if neither
+// side has the material left to mate
+void GameSession::updateResult(bool scored) {
+  Colour toMove = current.getCurrentTurn();
+  GameStatus status = current.gameStatus();
+
+  if (status == GameStatus::Checkmate) {
+    state = (toMove == Colour::White) ? GameResult::BlackWins : GameResult::WhiteWins;
+    if (scored) {
+      if (toMove == Colour::White) {
+        blackScore += 1.0;
+      } else {
+        whiteScore += 1.0;
+      }
+    }
+  } else if (status == GameStatus::Stalemate || status == GameStatus::DrawByRule) {
+    state = GameResult::Draw;
+    if (scored) {
+      whiteScore += 0.5;
+      blackScore += 0.5;
+    }
+  }
+}
+
+std::vector<Move> GameSession::legalMoves() const {
+  return getAllLegalMoves(current, current.getCurrentTurn());
+}
+
+// Reads only this session, so a copy may be searched on another thread
+bool GameSession::bestMove(const SearchLimits& limits, Move& chosenMove, MoveSource& source) const {
+  // Get all legal moves for the current player
+  std::vector<Move> legalMoves = getAllLegalMoves(current, current.getCurrentTurn());
+  
+  if (legalMoves.empty()) {
+    // No legal moves available - should be checkmate or stalemate
+    return false;
+  }
+  
+  // Play from the opening book while the position is still in it
+  source = MoveSource::Book;
+  if (limits.useBook && probeBook(current, legalMoves, chosenMove)) return true;
+  
+  // Small endings are played perfectly from the tablebases when loaded
+  source = MoveSource::Tablebase;
+  if (limits.useTablebase && probeTablebase(current, legalMoves, chosenMove)) return true;
+  
+  // A move found in advance (by pondering) is the answer if still legal
+  source = MoveSource::Search;
+  if (limits.hint && findLegalMove(legalMoves, *limits.hint, chosenMove)) return true;
+  
+  // Otherwise choose a move based on the difficulty level
+  chosenMove = getRandomMove(legalMoves); // Default to random (Level 1)
+  
+  switch (limits.level) {
+    case ComputerLevel::Level1:
+      // Level 1: Random legal moves (already set as default)
+      break;
+    
+    case ComputerLevel::Level2:
+      // Level 2: Prefers capturing moves and checks
+      chosenMove = getBestMoveLevel2(current, legalMoves, limits.parallel);
+      break;
+    
+    case ComputerLevel::Level3:
+      // Level 3: Prefers avoiding capture, capturing moves, and checks
+      chosenMove = getBestMoveLevel3(current, legalMoves, limits.parallel);
+      break;
+    
+    case ComputerLevel::Level4:
+      // Level 4: More sophisticated strategy with piece values and position evaluation
+      chosenMove = getBestMoveLevel4(current, legalMoves, evalTypeFor(limits.level), limits.stop,
+                                     limits.parallel);
+      break;
+  }
+  
+  return true;
+}
+
+GameResult GameSession::result() const {
+  return state;
+}
+
+bool GameSession::inProgress() const {
+  return state == GameResult::InProgress;
+}
+
+bool GameSession::isComputerTurn() const {
+  return inProgress() && playerType(current.getCurrentTurn()) == PlayerType::Computer;
+}
+
+bool GameSession::hasPosition() const {
+  return started;
+}
+
+const Board& GameSession::board() const {
+  return current;
+}
+
+double GameSession::score(Colour colour) const {
+  return (colour == Colour::White) ? whiteScore : blackScore;
+}
+
+void GameSession::setBook(std::shared_ptr<const OpeningBook> openingBook) {
+  book = std::move(openingBook);
+}
+
+void GameSession::setTablebase(std::shared_ptr<const Tablebase> tables) {
+  tablebase = std::move(tables);
+}
+
+void GameSession::setNetwork(std::shared_ptr<const NnueNetwork> net) {
+  network = std::move(net);
+}
+
+std::shared_ptr<const OpeningBook> GameSession::getBook() const {
+  return book;
+}
+
+std::shared_ptr<const Tablebase> GameSession::getTablebase() const {
+  return tablebase;
+}
+
+std::shared_ptr<const NnueNetwork> GameSession::getNetwork() const {
+  return network;
+}
+
+void GameSession::setEval(ComputerLevel level, EvalType evalType) {
+  levelEval[static_cast<int>(level)] = evalType;
+}
+
+EvalType GameSession::evalSetting(ComputerLevel level) const {
+  return levelEval[static_cast<int>(level)];
+}
+
+void GameSession::seed(uint32_t value) {
+  rng.seed(value);
+}
+
+// Get all legal moves for a given color
+std::vector<Move> GameSession::getAllLegalMoves(const Board& position, Colour colour) const {
+  std::vector<Move> legalMoves;
+  position.legalMoves(colour, MoveGenType::All, legalMoves);
+  return legalMoves;
+}
+
+// Look the current position up in the opening book. Book moves are only
+// accepted if they match one of the generated legal moves.
+bool GameSession::probeBook(const Board& position, const std::vector<Move>& legalMoves, Move& move) const {
+  if (!book || !book->isOpen()) return false;
+  
+  Move bookMove({0, 0}, {0, 0});
+  if (!book->probe(position, rng, bookMove)) return false;
+  
+  return findLegalMove(legalMoves, bookMove, move);
+}
+
+// Find the generated legal move matching wanted (same squares and promotion)
+bool GameSession::findLegalMove(const std::vector<Move>& legalMoves, const Move& wanted, Move& move) const {
+  for (const auto& legal : legalMoves) {
+    if (legal.from.file == wanted.from.file && legal.from.rank == wanted.from.rank &&
+        legal.to.file == wanted.to.file && legal.to.rank == wanted.to.rank &&
+        toupper(legal.promotion) == toupper(wanted.promotion)) {
+      move = legal;
+      return true;
+    }
+  }
+  
+  return false;
+}
+
+// Play a move on the given board, passing the promotion piece if there is one
+bool GameSession::applyMove(Board& position, const Move& move) const {
+  if (move.promotion != '\0') {
+    return position.move(move.from, move.to, move.promotion);
+  }
+  return position.move(move.from, move.to);
+}
+
+// Pick the move with the best tablebase outcome: the quickest win, else a
+// draw, else the longest resistance. Only used when every reply can be probed.
+bool GameSession::probeTablebase(const Board& position, const std::vector<Move>& legalMoves, Move& move) const {
+  if (!tablebase || !tablebase->isOpen()) return false;
+  
+  TablebaseResult current;
+  if (!tablebase->probe(position, current)) return false;
+  
+  bool found = false;
+  int bestScore = 0;
+  
+  for (const auto& candidate : legalMoves) {
+    Board tempBoard = position;
+    
+    bool moveSuccess = false;
+    if (candidate.promotion != '\0') {
+      moveSuccess = tempBoard.move(candidate.from, candidate.to, candidate.promotion);
+    } else {
+      moveSuccess = tempBoard.move(candidate.from, candidate.to);
+    }
+    
+    if (!moveSuccess) continue;
+    
+    TablebaseResult reply;
+    if (!tablebase->probe(tempBoard, reply)) return false;
+    
+    // Reply results are from the opponent's point of view
+    int score = 0;
+    if (reply.wdl < 0) {
+      score = 1000 - reply.dtm;
+    } else if (reply.wdl > 0) {
+      score = -1000 + reply.dtm;
+    }
+    
+    if (!found || score > bestScore) {
+      found = true;
+      bestScore = score;
+      move = candidate;
+    }
+  }
+  
+  return found;
+}
+
+// Get a random move from the list of legal moves
+Move GameSession::getRandomMove(const std::vector<Move>& moves) const {
+  if (moves.empty()) {
+    return Move({0, 0}, {0, 0});
+  }
+  
+  std::uniform_int_distribution<size_t> dist(0, moves.size() - 1);
+  return moves[dist(rng)];
+}
+
+// Pick at random among the moves of the lowest category; categories are
+// filled in by the caller, one per move
+Move GameSession::pickFromBestCategory(const std::vector<Move>& moves,
+                                       const std::vector<unsigned char>& category) const {
+  unsigned char best = *std::min_element(category.begin(), category.end());
+  size_t count = std::count(category.begin(), category.end(), best);
+  
+  std::uniform_int_distribution<size_t> dist(0, count - 1);
+  size_t pick = dist(rng);
+  for (size_t i = 0; i < moves.size(); ++i) {
+    if (category[i] == best && pick-- == 0) {
+      return moves[i];
+    }
+  }
+  return moves[0];
+}
+
+// Level 2: Prefers capturing moves and checks
+Move GameSession::getBestMoveLevel2(const Board& position, const std::vector<Move>& moves, bool parallel) const {
+  if (moves.empty()) {
+    return Move({0, 0}, {0, 0});
+  }
+  
+  // Analyse every move (possibly in parallel) into its own slot, so the
+  // choice does not depend on timing
+  std::vector<unsigned char> category(moves.size());
+  forEachMove(moves.size(), parallel, [&](size_t i) {
+    MoveFeatures features = analyseMove(position, moves[i]);
+    if (features.capture) {
+      category[i] = 0;
+    } else if (features.check) {
+      category[i] = 1;
+    } else {
+      category[i] = 2;
+    }
+  });
+  
+  return pickFromBestCategory(moves, category);
+}
+
+// Level 3: Prefers avoiding capture, capturing moves, and checks
+Move GameSession::getBestMoveLevel3(const Board& position, const std::vector<Move>& moves, bool parallel) const {
+  if (moves.empty()) {
+    return Move({0, 0}, {0, 0});
+  }
+  
+  // From the best category down: safe moves that capture and check, safe
+  // captures, safe checks, other safe moves, then captures, checks and all
+  // other moves that leave the piece en prise
+  std::vector<unsigned char> category(moves.size());
+  forEachMove(moves.size(), parallel, [&](size_t i) {
+    MoveFeatures features = analyseMove(position, moves[i]);
+    if (!features.hanging && features.capture && features.check) {
+      category[i] = 0;
+    } else if (!features.hanging && features.capture) {
+      category[i] = 1;
+    } else if (!features.hanging && features.check) {
+      category[i] = 2;
+    } else if (!features.hanging) {
+      category[i] = 3;
+    } else if (features.capture) {
+      category[i] = 4;
+    } else if (features.check) {
+      category[i] = 5;
+    } else {
+      category[i] = 6;
+    }
+  });
+  
+  return pickFromBestCategory(moves, category);
+}
+
+// Level 4
+Move GameSession::getBestMoveLevel4(const Board& position, const std::vector<Move>& moves,
+                                    EvalType evalType, const std::atomic<bool>* stop, bool parallel) const {
+  if (moves.empty()) {
+    return Move({0, 0}, {0, 0});
+  }
+  
+  Move bestMove = moves[0];
+  int bestScore = -999999; 
+  
+  Colour currentPlayer = position.getCurrentTurn();
+  
+  // With the network, the root's hidden layer is computed once and each
+  // reply only updates the squares its move changed
+  bool useNnue = (evalType == EvalType::Nnue);
+  NnueAccumulator rootAccumulator;
+  if (useNnue) {
+    network->refresh(position.snapshot(), rootAccumulator);
+  }
+  
+  // Each move is scored into its own slot; the first best in generation
+  // order wins, as in a serial scan
+  std::vector<int> scores(moves.size());
+  std::vector<char> scored(moves.size(), 0);
+  forEachMove(moves.size(), parallel, [&](size_t i) {
+    if (stop && stop->load()) return;
+    
+    // Create a temporary board to simulate the move
+    Board tempBoard = position;
+    
+    if (!applyMove(tempBoard, moves[i])) return;
+    
+    if (useNnue) {
+      NnueAccumulator accumulator = rootAccumulator;
+      network->update(position.snapshot(), tempBoard.snapshot(), accumulator);
+      scores[i] = evaluatePosition(tempBoard, currentPlayer, &accumulator);
+    } else {
+      scores[i] = evaluatePosition(tempBoard, currentPlayer);
+    }
+    scored[i] = 1;
+  });
+  
+  for (size_t i = 0; i < moves.size(); ++i) {
+    if (scored[i] && scores[i] > bestScore) {
+      bestScore = scores[i];
+      bestMove = moves[i];
+    }
+  }
+  
+  return bestMove;
+}
+
+// Multi-PV analysis
+std::vector<AnalysisLine> GameSession::analyse(int multiPv, int depth, const std::atomic<bool>* stop) const {
+  std::vector<AnalysisLine> lines;
+  if (!started) return lines;
+  
+  Colour mover = current.getCurrentTurn();
+  std::vector<Move> rootMoves;
+  current.legalMoves(mover, MoveGenType::Captures, rootMoves);
+  orderCaptures(current, rootMoves);
+  current.legalMoves(mover, MoveGenType::Quiets, rootMoves);
+  
+  NnueAccumulator rootAccumulator;
+  bool useNnue = (evalTypeFor(ComputerLevel::Level4) == EvalType::Nnue);
+  if (useNnue) {
+    network->refresh(current.snapshot(), rootAccumulator);
+  }
+  
+  // One pass over the root moves finds every line: each move is searched
+  // against the multiPv-th best score so far, so one that fails low cannot
+  // make the list and one that beats it gets its exact score. lines stays
+  // sorted best first, earlier moves first among equal scores.
+  size_t wanted = static_cast<size_t>(multiPv);
+  std::vector<Move> line;
+  for (const Move& move : rootMoves) {
+    int alpha = lines.size() < wanted ? -InfiniteScore : lines.back().score;
+    
+    Board next = current;
+    NnueAccumulator nextAccumulator;
+    if (!searchChild(current, move, next, useNnue ? &rootAccumulator : nullptr, nextAccumulator)) continue;
+    
+    int score = -alphaBeta(next, depth - 1, 1, -InfiniteScore, -alpha,
+                           useNnue ? &nextAccumulator : nullptr, stop, line);
+    if (stop && stop->load()) return {};
+    if (lines.size() == wanted && score <= alpha) continue;
+    
+    int mate = 0;
+    if (score > MateScore - 1000) {
+      mate = (MateScore - score + 1) / 2;
+    } else if (score < -MateScore + 1000) {
+      mate = -(MateScore + score) / 2;
+    }
+    AnalysisLine entry{move, score, mate, std::vector<Move>(1, move)};
+    entry.pv.insert(entry.pv.end(), line.begin(), line.end());
+    
+    auto at = std::upper_bound(lines.begin(), lines.end(), score,
+                               [](int value, const AnalysisLine& other) { return value > other.score; });
+    lines.insert(at, std::move(entry));
+    if (lines.size() > wanted) lines.pop_back();
+  }
+  
+  return lines;
+}
+
+// Negamax with alpha-beta pruning: the score is for the side to move in
+// position, and pv receives the moves that lead to it
+int GameSession::alphaBeta(const Board& position, int depth, int ply, int alpha, int beta,
+                           const NnueAccumulator* accumulator, const std::atomic<bool>* stop,
+                           std::vector<Move>& pv) const {
+  pv.clear();
+  if (stop && stop->load(std::memory_order_relaxed)) return alpha;
+  switch (position.gameStatus()) {
+    case GameStatus::Checkmate: return -(MateScore - ply);
+    case GameStatus::Stalemate:
+    case GameStatus::DrawByRule: return 0;
+    default: break;
+  }
+  if (depth <= 0) {
+    return quiesce(position, ply, alpha, beta, accumulator, stop, pv);
+  }
+  
+  // Captures first, the most valuable victims leading, prune the most
+  Colour mover = position.getCurrentTurn();
+  std::vector<Move> moves;
+  position.legalMoves(mover, MoveGenType::Captures, moves);
+  orderCaptures(position, moves);
+  position.legalMoves(mover, MoveGenType::Quiets, moves);
+  
+  std::vector<Move> line;
+  for (const Move& move : moves) {
+    Board next = position;
+    NnueAccumulator nextAccumulator;
+    if (!searchChild(position, move, next, accumulator, nextAccumulator)) continue;
+    
+    int score = -alphaBeta(next, depth - 1, ply + 1, -beta, -alpha,
+                           accumulator ? &nextAccumulator : nullptr, stop, line);
+    if (score > alpha) {
+      alpha = score;
+      pv.assign(1, move);
+      pv.insert(pv.end(), line.begin(), line.end());
+      if (alpha >= beta) break;
+    }
+  }
+  
+  return alpha;
+}
+
+// Captures only past the search depth, so a line never stops in the middle
+// of an exchange. The side to move may stand pat on the static evaluation.
+int GameSession::quiesce(const Board& position, int ply, int alpha, int beta,
+                         const NnueAccumulator* accumulator, const std::atomic<bool>* stop,
+                         std::vector<Move>& pv) const {
+  pv.clear();
+  if (stop && stop->load(std::memory_order_relaxed)) return alpha;
+  Colour mover = position.getCurrentTurn();
+  int standPat = evaluatePosition(position, mover, accumulator);
+  if (standPat >= beta) return beta;
+  if (standPat > alpha) alpha = standPat;
+  
+  std::vector<Move> captures;
+  position.legalMoves(mover, MoveGenType::Captures, captures);
+  orderCaptures(position, captures);
+  
+  std::vector<Move> line;
+  for (const Move& move : captures) {
+    Board next = position;
+    NnueAccumulator nextAccumulator;
+    if (!searchChild(position, move, next, accumulator, nextAccumulator)) continue;
+    
+    int score;
+    switch (next.gameStatus()) {
+      case GameStatus::Checkmate: score = MateScore - ply - 1; line.clear(); break;
+      case GameStatus::Stalemate:
+      case GameStatus::DrawByRule: score = 0; line.clear(); break;
+      default:
+        score = -quiesce(next, ply + 1, -beta, -alpha, accumulator ? &nextAccumulator : nullptr, stop, line);
+        break;
+    }
+    if (score > alpha) {
+      alpha = score;
+      pv.assign(1, move);
+      pv.insert(pv.end(), line.begin(), line.end());
+      if (alpha >= beta) break;
+    }
+  }
+  
+  return alpha;
+}
+
+// Most valuable victim first; en passant takes a pawn from an empty square
+void GameSession::orderCaptures(const Board& position, std::vector<Move>& captures) const {
+  auto victim = [&](const Move& move) {
+    auto piece = position.pieceAt(move.to);
+    return piece ? getPieceValue(piece->symbol()) : getPieceValue('P');
+  };
+  std::stable_sort(captures.begin(), captures.end(),
+                   [&](const Move& a, const Move& b) { return victim(a) > victim(b); });
+}
+
+// Play move on next, a copy of position, and bring the network's
+// accumulator along when the search uses one
+bool GameSession::searchChild(const Board& position, const Move& move, Board& next,
+                              const NnueAccumulator* accumulator, NnueAccumulator& nextAccumulator) const {
+  if (!applyMove(next, move)) return false;
+  
+  if (accumulator) {
+    nextAccumulator = *accumulator;
+    network->update(position.snapshot(), next.snapshot(), nextAccumulator);
+  }
+  return true;
+}
+
+EvalType GameSession::evalTypeFor(ComputerLevel level) const {
+  EvalType evalType = levelEval[static_cast<int>(level)];
+  return (evalType == EvalType::Nnue && network && network->isLoaded()) ? EvalType::Nnue : EvalType::Classic;
+}
+
+// Get the value of a piece
+int GameSession::getPieceValue(char pieceSymbol) const {
+  switch (toupper(pieceSymbol)) {
+    case 'P': return 100;   // Pawn
+    case 'N': return 320;   // Knight
+    case 'B': return 330;   // Bishop
+    case 'R': return 500;   // Rook
+    case 'Q': return 900;   // Queen
+    case 'K': return 20000; // King
+    default: return 0;
+  }
+}
+
+// Evaluate a board position from the perspective of the given color
+// With an accumulator the network's score (side to move's view) replaces
+// the material, piece-square and pawn terms
+int GameSession::evaluatePosition(const Board& board, Colour perspective,
+                                  const NnueAccumulator* accumulator) const {
+  // Nobody can win a dead position, whatever the material count says
+  if (board.isInsufficientMaterial()) {
+    return 0;
+  }
+  
+  int score = 0;
+  
+  if (accumulator) {
+    int netScore = network->evaluate(*accumulator, board.getCurrentTurn());
+    score += (board.getCurrentTurn() == perspective) ? netScore : -netScore;
+  } else {
+    // Material and piece-square tables over the whole mailbox (White's view)
+    int material = EvalKernel::evaluate(board.snapshot());
+    score += (perspective == Colour::White) ? material : -material;
+    
+    // Pawn structure and passed pawns come from the pawn hash (White's view)
+    const PawnEntry& pawns = PawnHashTable::local().probe(board);
+    int pawnScore = pawns.structure + pawns.passed;
+    score += (perspective == Colour::White) ? pawnScore : -pawnScore;
+  }
+  
+  Colour opponent = (perspective == Colour::White) ? Colour::Black : Colour::White;
+  if (board.isInCheck(opponent)) {
+    score += 50;
+  }
+  
+  if (board.isInCheck(perspective)) {
+    score -= 50;
+  }
+  
+  if (board.isCheckmate(opponent)) {
+    score += 10000;
+  }
+  
+  if (board.isCheckmate(perspective)) {
+    score -= 10000;
+  }
+  
+  return score;
+}
@@ -0,0 +1,154 @@
+#ifndef GAME_SESSION_H
+#define GAME_SESSION_H
+
+#include "Board.h"
+#include "Colour.h"
+#include "Move.h"
+#include "OpeningBook.h"
+#include "Tablebase.h"
+#include "Nnue.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+enum class PlayerType { Human, Computer };
+enum class ComputerLevel { Level1, Level2, Level3, Level4 };
+enum class MoveSource { Search, Book, Tablebase };
+enum class EvalType { Classic, Nnue };
+enum class GameResult { NotStarted, InProgress, WhiteWins, BlackWins, Draw };
+
+// What a computer move search may use. hint is a move found earlier (by
+// pondering); it is played if legal once the book and tablebases had nothing.
+// parallel spreads the analysis of the candidate moves over the shared
+// work-stealing pool; the chosen move is the same either way.
+struct SearchLimits {
+  ComputerLevel level;
+  const std::atomic<bool>* stop;
+  const Move* hint;
+  bool useBook;
+  bool useTablebase;
+  bool parallel;
+
+  explicit SearchLimits(ComputerLevel level = ComputerLevel::Level1)
+    : level{level}, stop{nullptr}, hint{nullptr}, useBook{true}, useTablebase{true}, parallel{true} {}
+};
+
+// One ranked move of an analysis. score is in centipawns for the side to
+// move; mate is the number of moves to a forced mate, negative when the side
+// to move is the one mated, 0 when none was found. pv starts with move.
+struct AnalysisLine {
+  Move move;
+  int score;
+  int mate;
+  std::vector<Move> pv;
+};
+
+// One game and its running score: the position, who plays each side and how
+// the computer chooses its moves. Nothing here prints or reads input, so
+// front ends (the terminal, X11, the server) only translate commands into
+// calls and results into text. Sessions are independent values: a copy can
+// be searched on another thread while the original keeps being played. The
+// book, tablebases and network are immutable and shared between copies.
+class GameSession {
+public:
+  GameSession();
+
+  void setPlayer(Colour colour, PlayerType type, ComputerLevel level = ComputerLevel::Level1);
+  PlayerType playerType(Colour colour) const;
+  ComputerLevel computerLevel(Colour colour) const;
+
+  // Start a game from the position, keeping the players and the score. A
+  // position that is already mate, stalemate or a dead draw (neither side
+  // can mate) ends the game unscored.
+  void start(const Board& position = Board());
+  // Play a move for the side to move; false if it is illegal or no game is
+  // in progress. Checkmate, stalemate and dead draws end the game and are
+  // scored.
+  bool apply(const Move& move);
+  void resign(Colour colour);
+  void declareDraw();
+
+  std::vector<Move> legalMoves() const;
+  // Choose a move for the side to move: book, tablebase, hint, then the
+  // level's own strategy. False if there is no legal move.
+  bool bestMove(const SearchLimits& limits, Move& move, MoveSource& source) const;
+
+  // Rank the best multiPv moves of the current position with an alpha-beta
+  // search of depth plies (plus captures), using level 4's evaluation. Each
+  // root move is searched once, against the multiPv-th best score so far, so
+  // the scores of the lines are exact. Empty if there is no position or no
+  // legal move, or once stop is set.
+  std::vector<AnalysisLine> analyse(int multiPv, int depth, const std::atomic<bool>* stop = nullptr) const;
+
+  GameResult result() const;
+  bool inProgress() const;
+  bool isComputerTurn() const;
+  bool hasPosition() const;  // false until the first game starts
+  const Board& board() const;
+  double score(Colour colour) const;
+
+  void setBook(std::shared_ptr<const OpeningBook> openingBook);
+  void setTablebase(std::shared_ptr<const Tablebase> tables);
+  void setNetwork(std::shared_ptr<const NnueNetwork> net);
+  std::shared_ptr<const OpeningBook> getBook() const;
+  std::shared_ptr<const Tablebase> getTablebase() const;
+  std::shared_ptr<const NnueNetwork> getNetwork() const;
+
+  // Evaluation used by each computer level; Nnue falls back to Classic
+  // while no network is loaded
+  void setEval(ComputerLevel level, EvalType evalType);
+  EvalType evalSetting(ComputerLevel level) const;
+  EvalType evalTypeFor(ComputerLevel level) const;
+
+  void seed(uint32_t value);
+
+  // Evaluate a position from the perspective of the given colour
+  int evaluatePosition(const Board& position, Colour perspective,
+                       const NnueAccumulator* accumulator = nullptr) const;
+
+private:
+  Board current;
+  GameResult state;
+  bool started;
+  double whiteScore;
+  double blackScore;
+
+  PlayerType whitePlayerType;
+  PlayerType blackPlayerType;
+  ComputerLevel whiteComputerLevel;
+  ComputerLevel blackComputerLevel;
+
+  mutable std::mt19937 rng;
+  std::shared_ptr<const OpeningBook> book;
+  std::shared_ptr<const Tablebase> tablebase;
+  std::shared_ptr<const NnueNetwork> network;
+  EvalType levelEval[4];
+
+  void updateResult(bool scored);
+
+  std::vector<Move> getAllLegalMoves(const Board& position, Colour colour) const;
+  bool applyMove(Board& position, const Move& move) const;
+  bool findLegalMove(const std::vector<Move>& legalMoves, const Move& wanted, Move& move) const;
+  bool probeBook(const Board& position, const std::vector<Move>& legalMoves, Move& move) const;
+  bool probeTablebase(const Board& position, const std::vector<Move>& legalMoves, Move& move) const;
+  Move getRandomMove(const std::vector<Move>& moves) const;
+  Move pickFromBestCategory(const std::vector<Move>& moves, const std::vector<unsigned char>& category) const;
+  Move getBestMoveLevel2(const Board& position, const std::vector<Move>& moves, bool parallel) const;
+  Move getBestMoveLevel3(const Board& position, const std::vector<Move>& moves, bool parallel) const;
+  Move getBestMoveLevel4(const Board& position, const std::vector<Move>& moves, EvalType evalType,
+                         const std::atomic<bool>* stop, bool parallel) const;
+  int getPieceValue(char pieceSymbol) const;
+  int alphaBeta(const Board& position, int depth, int ply, int alpha, int beta,
+                const NnueAccumulator* accumulator, const std::atomic<bool>* stop,
+                std::vector<Move>& pv) const;
+  int quiesce(const Board& position, int ply, int alpha, int beta,
+              const NnueAccumulator* accumulator, const std::atomic<bool>* stop,
+              std::vector<Move>& pv) const;
+  void orderCaptures(const Board& position, std::vector<Move>& captures) const;
+  bool searchChild(const Board& position, const Move& move, Board& next,
+                   const NnueAccumulator* accumulator, NnueAccumulator& nextAccumulator) const;
+};
+
+#endif
@@ -11,49 +11,66 @@ char King::symbol() const {
   return colour() == Colour::White ? 'K' : 'k';
 }
 
-std::vector<Pos> King::legalMoves(Board const& b, Pos from) const {
-  std::vector<Pos> moves;
-  
-  // All eight directions: horizontal, vertical, and diagonal (one step only)
-  const std::vector<std::pair<int, int>> directions = {
-    {1, 0}, {1, -1}, {0, -1}, {-1, -1},
-    {-1, 0}, {-1, 1}, {0, 1}, {1, 1}
-  };
-  
-  for (const auto& [df, dr] : directions) {
-    Pos dest{from.file + df, from.rank + dr};
-    if (b.isValidPos(dest)) {
-      auto piece = b.pieceAt(dest);
-      if (!piece || piece->colour() != colour()) {
-        moves.push_back(dest);
-      }
-    }
-  }
-  
-  // Check for castling moves
-  if (!b.hasKingMoved(colour()) && !b.isInCheck(colour())) {
-    int rank = (colour() == Colour::White) ? 0 : 7;
+namespace {
+  // The castling rank is a compile-time constant per side
+  template <Colour Us>
+  std::vector<Pos> kingMoves(Board const& b, Pos from) {
+    constexpr int rank = (Us == Colour::White) ? 0 : 7;
+    constexpr char rook = (Us == Colour::White) ? 'R' : 'r';
     
-    // Kingside castling
-    if (!b.hasRookMoved(colour(), true)) {
-      Pos rookPos{7, rank};
-      if (b.isPathClear(from, rookPos) && 
-          !b.isSquareAttacked({from.file + 1, rank}, colour()) && 
-          !b.isSquareAttacked({from.file + 2, rank}, colour())) {
-        moves.push_back({from.file + 2, rank});
+    std::vector<Pos> moves;
+    
+    // All eight directions: horizontal, vertical, and diagonal (one step only)
+    constexpr int directions[8][2] = {
+      {1, 0}, {1, -1}, {0, -1}, {-1, -1},
+      {-1, 0}, {-1, 1}, {0, 1}, {1, 1}
+    };
+    
+    for (const auto& direction : directions) {
+      Pos dest{from.file + direction[0], from.rank + direction[1]};
+      if (b.isValidPos(dest)) {
+        auto piece = b.pieceAt(dest);
+        if (!piece || piece->colour() != Us) {
+          moves.push_back(dest);
+        }
       }
     }
     
-    // Queenside castling
-    if (!b.hasRookMoved(colour(), false)) {
-      Pos rookPos{0, rank};
-      if (b.isPathClear(from, rookPos) && 
-          !b.isSquareAttacked({from.file - 1, rank}, colour()) && 
-          !b.isSquareAttacked({from.file - 2, rank}, colour())) {
-        moves.push_back({from.file - 2, rank});
+    // Check for castling moves. Set-up positions can leave the moved flags
+    // clear with the king or a rook elsewhere, so both are looked for.
+    auto hasRook = [&b](Pos p) {
+      auto piece = b.pieceAt(p);
+      return piece && piece->symbol() == rook;
+    };
+    if (from.file == 4 && from.rank == rank && !b.hasKingMoved(Us) && !b.isInCheck(Us)) {
+      // Kingside castling
+      if (!b.hasRookMoved(Us, true)) {
+        Pos rookPos{7, rank};
+        if (hasRook(rookPos) && b.isPathClear(from, rookPos) && 
+            !b.isSquareAttacked({from.file + 1, rank}, Us) && 
+            !b.isSquareAttacked({from.file + 2, rank}, Us)) {
+          moves.push_back({from.file + 2, rank});
+        }
+      }
+      
+      // Queenside castling
+      if (!b.hasRookMoved(Us, false)) {
+        Pos rookPos{0, rank};
+        if (hasRook(rookPos) && b.isPathClear(from, rookPos) && 
+            !b.isSquareAttacked({from.file - 1, rank}, Us) && 
+            !b.isSquareAttacked({from.file - 2, rank}, Us)) {
+          moves.push_back({from.file - 2, rank});
+        }
       }
     }
+    
+    return moves;
+  }
+}
+
+std::vector<Pos> King::legalMoves(Board const& b, Pos from) const {
+  if (colour() == Colour::White) {
+    return kingMoves<Colour::White>(b, from);
   }
-  
-  return moves;
-} 
+  return kingMoves<Colour::Black>(b, from);
+}
@@ -0,0 +1,13 @@
+#ifndef MOVE_H
+#define MOVE_H
+
+#include "Pos.h"
+
+struct Move {
+  Pos from;
+  Pos to;
+  char promotion;
+  Move(Pos f, Pos t, char p = '\0') : from(f), to(t), promotion(p) {}
+};
+
+#endif
@@ -0,0 +1,29 @@
+#include "MoveFeatures.h"
+#include "Board.h"
+#include "Colour.h"
+#include "Piece.h"
+
+MoveFeatures analyseMove(const Board& position, const Move& move) {
+  MoveFeatures features{false, false, false, false, '\0'};
+
+  Colour mover = position.getCurrentTurn();
+  Colour opponent = (mover == Colour::White) ? Colour::Black : Colour::White;
+  auto piece = position.pieceAt(move.from);
+  auto target = position.pieceAt(move.to);
+  bool isPawn = piece && (piece->symbol() == 'P' || piece->symbol() == 'p');
+
+  if (target && target->colour() != mover) {
+    features.captured = target->symbol();
+  } else if (isPawn && !target && move.to.file != move.from.file) {
+    features.captured = (mover == Colour::White) ? 'p' : 'P';
+  }
+  features.capture = (features.captured != '\0');
+  features.promotion = isPawn && (move.to.rank == 7 || move.to.rank == 0);
+
+  Board after = position;
+  after.makeMove(move);
+  features.check = after.isInCheck(opponent);
+  features.hanging = after.isSquareAttacked(move.to, mover);
+
+  return features;
+}
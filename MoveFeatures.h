@@ -0,0 +1,20 @@
+#ifndef MOVE_FEATURES_H
+#define MOVE_FEATURES_H
+
+#include "Board.h"
+#include "Move.h"
+
+// What a candidate move does, found by playing it once on a copy of the
+// position. The computer levels choose between moves by these flags.
+struct MoveFeatures {
+  bool capture;    // takes a piece, en passant included
+  bool check;      // leaves the opponent in check
+  bool hanging;    // the moved piece can be taken on its new square
+  bool promotion;
+  char captured;   // symbol of the captured piece, '\0' for none
+};
+
+// move must be one of position's generated legal moves
+MoveFeatures analyseMove(const Board& position, const Move& move);
+
+#endif
@@ -0,0 +1,338 @@
+#include "Nnue.h"
+#include "BoardState.h"
+#include "Colour.h"
+#include "EvalKernel.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NNUE_X86 1
+#endif
+
+namespace {
+  // File layout, all little-endian:
+  //   "NNUE", version (u32), hidden (u32), dense (u32), output scale (i32)
+  //   feature biases i16[hidden], feature weights i16[768][hidden]
+  //   dense biases i32[dense], dense weights i8[dense][2 * hidden]
+  //   output bias i32, output weights i8[dense]
+  const char magic[4] = {'N', 'N', 'U', 'E'};
+  const int64_t formatVersion = 1;
+
+  // Activations are clipped to 0..127 (1.0) and dense weights carry a
+  // factor of 64, which is shifted back out after each dense layer
+  const int activationMax = 127;
+  const int weightShift = 6;
+
+  class Reader {
+  public:
+    explicit Reader(const std::vector<char>& bytes) : bytes{bytes}, offset{0} {}
+
+    bool read(unsigned char* out, size_t count) {
+      if (bytes.size() - offset < count) return false;
+      std::copy(bytes.begin() + offset, bytes.begin() + offset + count, out);
+      offset += count;
+      return true;
+    }
+
+    // Little-endian two's complement integer of 1, 2 or 4 bytes
+    bool readInt(int64_t& value, int size) {
+      unsigned char raw[4];
+      if (!read(raw, size)) return false;
+      uint64_t bits = 0;
+      for (int i = size - 1; i >= 0; --i) {
+        bits = (bits << 8) | raw[i];
+      }
+      int width = size * 8;
+      value = static_cast<int64_t>(bits);
+      if (bits >> (width - 1)) value -= int64_t{1} << width;
+      return true;
+    }
+
+    template <typename T>
+    bool readArray(std::vector<T>& values, size_t count) {
+      values.resize(count);
+      for (auto& value : values) {
+        int64_t raw;
+        if (!readInt(raw, sizeof(T))) return false;
+        value = static_cast<T>(raw);
+      }
+      return true;
+    }
+
+    bool atEnd() const { return offset == bytes.size(); }
+
+  private:
+    const std::vector<char>& bytes;
+    size_t offset;
+  };
+
+  int pieceType(char symbol) {
+    switch (symbol & ~0x20) {
+      case 'P': return 0;
+      case 'N': return 1;
+      case 'B': return 2;
+      case 'R': return 3;
+      case 'Q': return 4;
+      default: return 5;
+    }
+  }
+
+  // Input index of a piece as seen by one side: its own pieces come first
+  // and Black sees the board flipped, so both sides share the same weights
+  int featureIndex(char symbol, int square, Colour perspective) {
+    bool white = symbol < 'a';
+    bool own = white == (perspective == Colour::White);
+    int relativeSquare = (perspective == Colour::White) ? square : square ^ 56;
+    return ((own ? 0 : 6) + pieceType(symbol)) * 64 + relativeSquare;
+  }
+
+  // Clip both halves of the hidden layer to 0..127 bytes, the side to move's
+  // half first
+  void transformScalar(const int16_t* us, const int16_t* them, int hidden, uint8_t* out) {
+    for (int i = 0; i < hidden; ++i) {
+      out[i] = static_cast<uint8_t>(std::clamp<int>(us[i], 0, activationMax));
+      out[hidden + i] = static_cast<uint8_t>(std::clamp<int>(them[i], 0, activationMax));
+    }
+  }
+
+  int32_t dotScalar(const uint8_t* input, const int8_t* weights, int count) {
+    int32_t sum = 0;
+    for (int i = 0; i < count; ++i) {
+      sum += input[i] * weights[i];
+    }
+    return sum;
+  }
+
+#ifdef NNUE_X86
+  __attribute__((target("sse2")))
+  void transformSSE2(const int16_t* us, const int16_t* them, int hidden, uint8_t* out) {
+    const __m128i limit = _mm_set1_epi8(activationMax);
+    const int16_t* halves[2] = {us, them};
+    for (int half = 0; half < 2; ++half) {
+      const int16_t* values = halves[half];
+      for (int i = 0; i < hidden; i += 16) {
+        __m128i low = _mm_load_si128(reinterpret_cast<const __m128i*>(values + i));
+        __m128i high = _mm_load_si128(reinterpret_cast<const __m128i*>(values + i + 8));
+        __m128i clipped = _mm_min_epu8(_mm_packus_epi16(low, high), limit);
+        _mm_store_si128(reinterpret_cast<__m128i*>(out + half * hidden + i), clipped);
+      }
+    }
+  }
+
+  // Bytes are widened to 16 bits (zero- and sign-extended) for pmaddwd
+  __attribute__((target("sse2")))
+  int32_t dotSSE2(const uint8_t* input, const int8_t* weights, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    for (int i = 0; i < count; i += 16) {
+      __m128i in = _mm_load_si128(reinterpret_cast<const __m128i*>(input + i));
+      __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+      __m128i sign = _mm_cmpgt_epi8(zero, w);
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(in, zero), _mm_unpacklo_epi8(w, sign)));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(in, zero), _mm_unpackhi_epi8(w, sign)));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+  }
+
+  // packus works per 128-bit lane, so the quadwords are put back in order
+  __attribute__((target("avx2")))
+  void transformAVX2(const int16_t* us, const int16_t* them, int hidden, uint8_t* out) {
+    const __m256i limit = _mm256_set1_epi8(activationMax);
+    const int16_t* halves[2] = {us, them};
+    for (int half = 0; half < 2; ++half) {
+      const int16_t* values = halves[half];
+      for (int i = 0; i < hidden; i += 32) {
+        __m256i low = _mm256_load_si256(reinterpret_cast<const __m256i*>(values + i));
+        __m256i high = _mm256_load_si256(reinterpret_cast<const __m256i*>(values + i + 16));
+        __m256i packed = _mm256_packus_epi16(low, high);
+        __m256i clipped = _mm256_min_epu8(_mm256_permute4x64_epi64(packed, 0xD8), limit);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(out + half * hidden + i), clipped);
+      }
+    }
+  }
+
+  // pmaddubsw multiplies unsigned inputs by signed weights; with inputs at
+  // most 127 the pairwise 16-bit sums cannot saturate
+  __attribute__((target("avx2")))
+  int32_t dotAVX2(const uint8_t* input, const int8_t* weights, int count) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < count; i += 32) {
+      __m256i in = _mm256_load_si256(reinterpret_cast<const __m256i*>(input + i));
+      __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(in, w), ones));
+    }
+    __m128i folded = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    folded = _mm_add_epi32(folded, _mm_shuffle_epi32(folded, 0x4E));
+    folded = _mm_add_epi32(folded, _mm_shuffle_epi32(folded, 0xB1));
+    return _mm_cvtsi128_si32(folded);
+  }
+#endif
+
+  typedef void (*TransformFunction)(const int16_t*, const int16_t*, int, uint8_t*);
+  typedef int32_t (*DotFunction)(const uint8_t*, const int8_t*, int);
+
+  TransformFunction transformFor(EvalKernel::Isa isa) {
+#ifdef NNUE_X86
+    if (isa == EvalKernel::Isa::AVX2) return transformAVX2;
+    if (isa == EvalKernel::Isa::SSE2) return transformSSE2;
+#endif
+    (void)isa;
+    return transformScalar;
+  }
+
+  DotFunction dotFor(EvalKernel::Isa isa) {
+#ifdef NNUE_X86
+    if (isa == EvalKernel::Isa::AVX2) return dotAVX2;
+    if (isa == EvalKernel::Isa::SSE2) return dotSSE2;
+#endif
+    (void)isa;
+    return dotScalar;
+  }
+}
+
+NnueNetwork::NnueNetwork() : hidden{0}, dense{0}, outputScale{0}, outputBias{0} {}
+
+bool NnueNetwork::load(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  Reader reader(bytes);
+  unsigned char header[4];
+  if (!reader.read(header, 4) || !std::equal(header, header + 4, magic)) return false;
+
+  int64_t version, hiddenCount, denseCount, scale, bias;
+  if (!reader.readInt(version, 4) || version != formatVersion) return false;
+  if (!reader.readInt(hiddenCount, 4) || !reader.readInt(denseCount, 4) || !reader.readInt(scale, 4)) {
+    return false;
+  }
+
+  // The vector versions step through the hidden layer 32 units at a time
+  if (hiddenCount <= 0 || hiddenCount > NnueAccumulator::MaxHidden || hiddenCount % 32 != 0) return false;
+  if (denseCount <= 0 || denseCount > MaxDense) return false;
+
+  std::vector<int16_t> newFeatureBiases, newFeatureWeights;
+  std::vector<int32_t> newDenseBiases;
+  std::vector<int8_t> newDenseWeights, newOutputWeights;
+  if (!reader.readArray(newFeatureBiases, hiddenCount) ||
+      !reader.readArray(newFeatureWeights, static_cast<size_t>(Features) * hiddenCount) ||
+      !reader.readArray(newDenseBiases, denseCount) ||
+      !reader.readArray(newDenseWeights, static_cast<size_t>(denseCount) * 2 * hiddenCount) ||
+      !reader.readInt(bias, 4) ||
+      !reader.readArray(newOutputWeights, denseCount) ||
+      !reader.atEnd()) {
+    return false;
+  }
+
+  hidden = static_cast<int>(hiddenCount);
+  dense = static_cast<int>(denseCount);
+  outputScale = static_cast<int>(scale);
+  featureBiases.swap(newFeatureBiases);
+  featureWeights.swap(newFeatureWeights);
+  denseBiases.swap(newDenseBiases);
+  denseWeights.swap(newDenseWeights);
+  outputBias = static_cast<int32_t>(bias);
+  outputWeights.swap(newOutputWeights);
+  return true;
+}
+
+bool NnueNetwork::isLoaded() const {
+  return hidden > 0;
+}
+
+int NnueNetwork::hiddenSize() const {
+  return hidden;
+}
+
+int NnueNetwork::denseSize() const {
+  return dense;
+}
+
+void NnueNetwork::addFeature(int16_t* values, int feature) const {
+  const int16_t* weights = featureWeights.data() + static_cast<size_t>(feature) * hidden;
+  for (int i = 0; i < hidden; ++i) {
+    values[i] = static_cast<int16_t>(values[i] + weights[i]);
+  }
+}
+
+void NnueNetwork::removeFeature(int16_t* values, int feature) const {
+  const int16_t* weights = featureWeights.data() + static_cast<size_t>(feature) * hidden;
+  for (int i = 0; i < hidden; ++i) {
+    values[i] = static_cast<int16_t>(values[i] - weights[i]);
+  }
+}
+
+void NnueNetwork::refresh(const BoardState& state, NnueAccumulator& accumulator) const {
+  for (Colour perspective : {Colour::White, Colour::Black}) {
+    int16_t* values = accumulator.values[static_cast<int>(perspective)];
+    std::copy(featureBiases.begin(), featureBiases.end(), values);
+    for (int square = 0; square < 64; ++square) {
+      char symbol = state.squares[square];
+      if (symbol) addFeature(values, featureIndex(symbol, square, perspective));
+    }
+  }
+}
+
+// A move changes at most four squares (castling), so only those features
+// are removed and added again
+void NnueNetwork::update(const BoardState& before, const BoardState& after,
+                         NnueAccumulator& accumulator) const {
+  uint64_t changed = 0;
+  for (int side = 0; side < 2; ++side) {
+    for (int type = 0; type < 6; ++type) {
+      changed |= before.pieces[side][type] ^ after.pieces[side][type];
+    }
+  }
+
+  for (; changed; changed &= changed - 1) {
+    int square = std::countr_zero(changed);
+    char was = before.squares[square];
+    char now = after.squares[square];
+
+    for (Colour perspective : {Colour::White, Colour::Black}) {
+      int16_t* values = accumulator.values[static_cast<int>(perspective)];
+      if (was) removeFeature(values, featureIndex(was, square, perspective));
+      if (now) addFeature(values, featureIndex(now, square, perspective));
+    }
+  }
+}
+
+int NnueNetwork::evaluate(const NnueAccumulator& accumulator, Colour sideToMove) const {
+  return evaluate(accumulator, sideToMove, EvalKernel::best());
+}
+
+int NnueNetwork::evaluate(const NnueAccumulator& accumulator, Colour sideToMove,
+                          EvalKernel::Isa isa) const {
+  if (!isLoaded()) return 0;
+  if (!EvalKernel::supported(isa)) isa = EvalKernel::Isa::Scalar;
+
+  int us = static_cast<int>(sideToMove);
+  alignas(32) uint8_t input[2 * NnueAccumulator::MaxHidden];
+  transformFor(isa)(accumulator.values[us], accumulator.values[1 - us], hidden, input);
+
+  DotFunction dot = dotFor(isa);
+  int32_t output = outputBias;
+  for (int unit = 0; unit < dense; ++unit) {
+    int32_t sum = denseBiases[unit] + dot(input, denseWeights.data() + static_cast<size_t>(unit) * 2 * hidden, 2 * hidden);
+    int activation = std::clamp<int32_t>(sum >> weightShift, 0, activationMax);
+    output += activation * outputWeights[unit];
+  }
+
+  return static_cast<int>(static_cast<int64_t>(output) * outputScale / (activationMax << weightShift));
+}
+
+int NnueNetwork::evaluate(const BoardState& state) const {
+  NnueAccumulator accumulator;
+  refresh(state, accumulator);
+  return evaluate(accumulator, state.currentTurn);
+}
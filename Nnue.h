@@ -0,0 +1,63 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "BoardState.h"
+#include "Colour.h"
+#include "EvalKernel.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Hidden layer of the network for both perspectives, indexed by Colour.
+// Searches copy it along with the board and update it from the squares the
+// move changed instead of recomputing it.
+struct NnueAccumulator {
+  static const int MaxHidden = 256;
+  alignas(32) int16_t values[2][MaxHidden];
+};
+
+// Efficiently updatable evaluation network. Each perspective sees 768 binary
+// inputs (own/their piece type x square, squares mirrored for Black) feeding
+// a hidden layer kept in an NnueAccumulator. The side to move's half and the
+// opponent's half are clipped to 0..127, concatenated and passed through one
+// clipped-ReLU dense layer and a single output. Weights are quantised: int16
+// for the inputs, int8 (scaled by 64) for the dense layers.
+class NnueNetwork {
+public:
+  static const int Features = 768;
+  static const int MaxDense = 32;
+
+  NnueNetwork();
+
+  // Replaces the current weights; on failure the old ones are kept
+  bool load(const std::string& path);
+  bool isLoaded() const;
+  int hiddenSize() const;
+  int denseSize() const;
+
+  void refresh(const BoardState& state, NnueAccumulator& accumulator) const;
+  // accumulator holds the hidden layer of before; afterwards that of after
+  void update(const BoardState& before, const BoardState& after, NnueAccumulator& accumulator) const;
+
+  // Centipawns from the side to move's point of view. The dense layers use
+  // the same vector versions as EvalKernel; Isa::Scalar is the reference.
+  int evaluate(const NnueAccumulator& accumulator, Colour sideToMove) const;
+  int evaluate(const NnueAccumulator& accumulator, Colour sideToMove, EvalKernel::Isa isa) const;
+  int evaluate(const BoardState& state) const;
+
+private:
+  int hidden;
+  int dense;
+  int outputScale;  // centipawns per unit of output (127 * 64 raw)
+  std::vector<int16_t> featureBiases;
+  std::vector<int16_t> featureWeights;  // [Features][hidden]
+  std::vector<int32_t> denseBiases;
+  std::vector<int8_t> denseWeights;     // [dense][2 * hidden]
+  int32_t outputBias;
+  std::vector<int8_t> outputWeights;    // [dense]
+
+  void addFeature(int16_t* values, int feature) const;
+  void removeFeature(int16_t* values, int feature) const;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "OpeningBook.h"
+#include "Board.h"
+#include "Move.h"
+#include "Pos.h"
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  // Each Polyglot entry is 16 big-endian bytes: key(8) move(2) weight(2) learn(4)
+  const size_t entrySize = 16;
+
+  uint64_t readBigEndian(const unsigned char* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+      value = (value << 8) | p[i];
+    }
+    return value;
+  }
+}
+
+OpeningBook::OpeningBook() : data{nullptr}, length{0}, entryCount{0} {}
+
+OpeningBook::~OpeningBook() {
+  close();
+}
+
+bool OpeningBook::open(const std::string& path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(entrySize)) {
+    ::close(fd);
+    return false;
+  }
+
+  void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) return false;
+
+  data = static_cast<const unsigned char*>(mapped);
+  length = st.st_size;
+  entryCount = length / entrySize;
+  return true;
+}
+
+void OpeningBook::close() {
+  if (data) {
+    munmap(const_cast<unsigned char*>(data), length);
+  }
+  data = nullptr;
+  length = 0;
+  entryCount = 0;
+}
+
+bool OpeningBook::isOpen() const {
+  return data != nullptr;
+}
+
+size_t OpeningBook::size() const {
+  return entryCount;
+}
+
+uint64_t OpeningBook::keyAt(size_t index) const {
+  return readBigEndian(data + index * entrySize, 8);
+}
+
+uint16_t OpeningBook::moveAt(size_t index) const {
+  return static_cast<uint16_t>(readBigEndian(data + index * entrySize + 8, 2));
+}
+
+uint16_t OpeningBook::weightAt(size_t index) const {
+  return static_cast<uint16_t>(readBigEndian(data + index * entrySize + 10, 2));
+}
+
+size_t OpeningBook::lowerBound(uint64_t key) const {
+  size_t low = 0;
+  size_t high = entryCount;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (keyAt(mid) < key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+// Polyglot packs to-file, to-row, from-file, from-row and promotion into
+// 3 bits each. Castling is stored as the king capturing its own rook.
+Move OpeningBook::decodeMove(const Board& board, uint16_t raw) const {
+  Pos to{raw & 7, (raw >> 3) & 7};
+  Pos from{(raw >> 6) & 7, (raw >> 9) & 7};
+  int promotion = (raw >> 12) & 7;
+
+  const char promotionPieces[] = {'\0', 'N', 'B', 'R', 'Q'};
+  char promo = (promotion >= 1 && promotion <= 4) ? promotionPieces[promotion] : '\0';
+
+  auto piece = board.pieceAt(from);
+  if (piece && (piece->symbol() == 'K' || piece->symbol() == 'k') &&
+      from.file == 4 && to.rank == from.rank) {
+    if (to.file == 7) to.file = 6;
+    else if (to.file == 0) to.file = 2;
+  }
+
+  return Move(from, to, promo);
+}
+
+bool OpeningBook::probe(const Board& board, std::mt19937& rng, Move& move) const {
+  if (!data) return false;
+
+  uint64_t key = board.hash();
+  size_t first = lowerBound(key);
+
+  uint32_t totalWeight = 0;
+  size_t last = first;
+  while (last < entryCount && keyAt(last) == key) {
+    totalWeight += weightAt(last);
+    ++last;
+  }
+
+  if (first == last) return false;
+
+  // All-zero weights still leave every entry playable with equal chance
+  bool uniform = (totalWeight == 0);
+  if (uniform) totalWeight = static_cast<uint32_t>(last - first);
+
+  std::uniform_int_distribution<uint32_t> dist(0, totalWeight - 1);
+  uint32_t pick = dist(rng);
+
+  for (size_t i = first; i < last; ++i) {
+    uint32_t weight = uniform ? 1 : weightAt(i);
+    if (pick < weight) {
+      move = decodeMove(board, moveAt(i));
+      return true;
+    }
+    pick -= weight;
+  }
+
+  move = decodeMove(board, moveAt(last - 1));
+  return true;
+}
@@ -0,0 +1,41 @@
+#ifndef OPENING_BOOK_H
+#define OPENING_BOOK_H
+
+#include "Board.h"
+#include "Move.h"
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+// Read-only Polyglot (.bin) opening book. The file is memory-mapped and
+// probed by binary search on Board::hash(), so lookups never allocate.
+class OpeningBook {
+public:
+  OpeningBook();
+  ~OpeningBook();
+  OpeningBook(const OpeningBook&) = delete;
+  OpeningBook& operator=(const OpeningBook&) = delete;
+
+  bool open(const std::string& path);
+  void close();
+  bool isOpen() const;
+  size_t size() const;
+
+  // Picks one of the book moves for this position, weighted by the entry
+  // weights. Returns false when the position is not in the book.
+  bool probe(const Board& board, std::mt19937& rng, Move& move) const;
+
+private:
+  const unsigned char* data;
+  size_t length;
+  size_t entryCount;
+
+  uint64_t keyAt(size_t index) const;
+  uint16_t moveAt(size_t index) const;
+  uint16_t weightAt(size_t index) const;
+  size_t lowerBound(uint64_t key) const;
+  Move decodeMove(const Board& board, uint16_t raw) const;
+};
+
+#endif
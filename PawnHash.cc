@@ -0,0 +1,167 @@
+#include "PawnHash.h"
+#include "Board.h"
+#include "Colour.h"
+#include "Pos.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace {
+  const int doubledPenalty = 10;
+  const int isolatedPenalty = 15;
+  // Indexed by how far the pawn has advanced (0 = own back rank)
+  const int passedBonus[8] = {0, 5, 10, 20, 35, 60, 100, 0};
+
+  // Every thread's table, so the statistics cover whichever threads did the
+  // evaluating. Never destroyed: pool threads may exit after static
+  // destructors have run.
+  struct Registry {
+    std::mutex mutex;
+    std::vector<const PawnHashTable*> tables;
+    uint64_t retiredProbes = 0;
+    uint64_t retiredHits = 0;
+  };
+
+  Registry& registry() {
+    static Registry* instance = new Registry;
+    return *instance;
+  }
+
+  struct LocalTable {
+    PawnHashTable table;
+
+    LocalTable() {
+      std::lock_guard<std::mutex> lock(registry().mutex);
+      registry().tables.push_back(&table);
+    }
+
+    ~LocalTable() {
+      Registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.retiredProbes += table.probes();
+      r.retiredHits += table.hits();
+      r.tables.erase(std::find(r.tables.begin(), r.tables.end(), &table));
+    }
+  };
+
+  // Only the owner writes, so a plain load and store is enough
+  void bump(std::atomic<uint64_t>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+}
+
+PawnHashTable::PawnHashTable(size_t entries) : table(entries) {}
+
+PawnHashTable& PawnHashTable::local() {
+  thread_local LocalTable local;
+  return local.table;
+}
+
+void PawnHashTable::totals(uint64_t& probes, uint64_t& hits) {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  probes = r.retiredProbes;
+  hits = r.retiredHits;
+  for (const PawnHashTable* table : r.tables) {
+    probes += table->probes();
+    hits += table->hits();
+  }
+}
+
+const PawnEntry& PawnHashTable::probe(const Board& board) {
+  uint64_t key = board.pawnHash();
+  PawnEntry& entry = table[key & (table.size() - 1)];
+
+  bump(probeCount);
+  if (entry.valid && entry.key == key) {
+    bump(hitCount);
+    return entry;
+  }
+
+  entry = PawnEntry{};
+  entry.key = key;
+  evaluate(board, entry);
+  entry.valid = true;
+  return entry;
+}
+
+void PawnHashTable::clear() {
+  for (auto& entry : table) {
+    entry = PawnEntry{};
+  }
+  probeCount.store(0, std::memory_order_relaxed);
+  hitCount.store(0, std::memory_order_relaxed);
+}
+
+uint64_t PawnHashTable::probes() const {
+  return probeCount.load(std::memory_order_relaxed);
+}
+
+uint64_t PawnHashTable::hits() const {
+  return hitCount.load(std::memory_order_relaxed);
+}
+
+double PawnHashTable::hitRate() const {
+  uint64_t probeTotal = probes();
+  return probeTotal ? static_cast<double>(hits()) / probeTotal : 0.0;
+}
+
+void PawnHashTable::evaluate(const Board& board, PawnEntry& entry) {
+  // pawnRanks[colour][file] holds a bit per rank occupied by that side's pawns
+  uint8_t pawnRanks[2][8] = {};
+
+  for (int side = 0; side < 2; ++side) {
+    Colour colour = (side == 0) ? Colour::White : Colour::Black;
+    for (uint64_t pawns = board.pieces(colour, PieceType::Pawn); pawns; pawns &= pawns - 1) {
+      int square = std::countr_zero(pawns);
+      pawnRanks[side][square % 8] |= 1 << (square / 8);
+    }
+  }
+
+  int structure = 0;
+  int passed = 0;
+
+  for (int side = 0; side < 2; ++side) {
+    int sign = (side == 0) ? 1 : -1;
+    int enemy = 1 - side;
+
+    for (int file = 0; file < 8; ++file) {
+      uint8_t ranks = pawnRanks[side][file];
+      if (!ranks) continue;
+
+      int count = __builtin_popcount(ranks);
+      if (count > 1) {
+        structure -= sign * doubledPenalty * (count - 1);
+      }
+
+      bool leftFriend = file > 0 && pawnRanks[side][file - 1];
+      bool rightFriend = file < 7 && pawnRanks[side][file + 1];
+      if (!leftFriend && !rightFriend) {
+        structure -= sign * isolatedPenalty * count;
+      }
+
+      // Enemy pawns on this and the adjacent files
+      uint8_t blockers = pawnRanks[enemy][file];
+      if (file > 0) blockers |= pawnRanks[enemy][file - 1];
+      if (file < 7) blockers |= pawnRanks[enemy][file + 1];
+
+      for (int rank = 0; rank < 8; ++rank) {
+        if (!(ranks & (1 << rank))) continue;
+
+        // Ranks strictly in front of the pawn from its owner's point of view
+        uint8_t ahead = (side == 0) ? static_cast<uint8_t>(0xFF << (rank + 1))
+                                    : static_cast<uint8_t>((1 << rank) - 1);
+        if (!(blockers & ahead)) {
+          int advanced = (side == 0) ? rank : 7 - rank;
+          passed += sign * passedBonus[advanced];
+          entry.passedFiles[side] |= 1 << file;
+        }
+      }
+    }
+  }
+
+  entry.structure = static_cast<int16_t>(structure);
+  entry.passed = static_cast<int16_t>(passed);
+}
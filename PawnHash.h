@@ -0,0 +1,44 @@
+#ifndef PAWN_HASH_H
+#define PAWN_HASH_H
+
+#include "Board.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Pawn-structure terms, scored from White's point of view
+struct PawnEntry {
+  uint64_t key = 0;
+  int16_t structure = 0;  // doubled and isolated pawns
+  int16_t passed = 0;     // passed pawn bonus
+  uint8_t passedFiles[2] = {0, 0}; // bit per file, indexed by Colour
+  bool valid = false;
+};
+
+// Small always-replace cache keyed by Board::pawnHash(). Each thread that
+// evaluates positions gets its own table through local(). Only the owning
+// thread probes a table; its counters may be read from any thread.
+class PawnHashTable {
+public:
+  explicit PawnHashTable(size_t entries = 1 << 14);
+  const PawnEntry& probe(const Board& board);
+  void clear();
+
+  uint64_t probes() const;
+  uint64_t hits() const;
+  double hitRate() const;
+
+  static PawnHashTable& local();
+  // Counters summed over every thread's table, including threads that
+  // have exited since
+  static void totals(uint64_t& probes, uint64_t& hits);
+
+private:
+  std::vector<PawnEntry> table;
+  std::atomic<uint64_t> probeCount{0};
+  std::atomic<uint64_t> hitCount{0};
+
+  static void evaluate(const Board& board, PawnEntry& entry);
+};
+
+#endif
@@ -1,5 +1,29 @@
 #include "Piece.h"
 #include "Colour.h"
+#include "Pawn.h"
+#include "Knight.h"
+#include "Bishop.h"
+#include "Rook.h"
+#include "Queen.h"
+#include "King.h"
+
+namespace {
+  // The shared instance of every piece kind
+  struct PieceSet {
+    Pawn whitePawn{Colour::White};
+    Knight whiteKnight{Colour::White};
+    Bishop whiteBishop{Colour::White};
+    Rook whiteRook{Colour::White};
+    Queen whiteQueen{Colour::White};
+    King whiteKing{Colour::White};
+    Pawn blackPawn{Colour::Black};
+    Knight blackKnight{Colour::Black};
+    Bishop blackBishop{Colour::Black};
+    Rook blackRook{Colour::Black};
+    Queen blackQueen{Colour::Black};
+    King blackKing{Colour::Black};
+  };
+}
 
 Piece::Piece(Colour c): c{c} {}
 
@@ -7,4 +31,24 @@ Piece::~Piece() {}
 
 Colour Piece::colour() const {
   return c;
+}
+
+const Piece* Piece::get(char symbol) {
+  static const PieceSet pieces;
+  
+  switch (symbol) {
+    case 'P': return &pieces.whitePawn;
+    case 'N': return &pieces.whiteKnight;
+    case 'B': return &pieces.whiteBishop;
+    case 'R': return &pieces.whiteRook;
+    case 'Q': return &pieces.whiteQueen;
+    case 'K': return &pieces.whiteKing;
+    case 'p': return &pieces.blackPawn;
+    case 'n': return &pieces.blackKnight;
+    case 'b': return &pieces.blackBishop;
+    case 'r': return &pieces.blackRook;
+    case 'q': return &pieces.blackQueen;
+    case 'k': return &pieces.blackKing;
+    default: return nullptr;
+  }
 } 
@@ -15,6 +15,10 @@ public:
   Colour colour() const;
   virtual char symbol() const = 0;
   virtual std::vector<Pos> legalMoves(Board const& b, Pos from) const = 0;
+
+  // Pieces hold no per-square state, so each of the twelve kinds exists
+  // once and boards share them. Returns nullptr for an unknown symbol.
+  static const Piece* get(char symbol);
 private:
   Colour c;
 };
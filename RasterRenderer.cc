@@ -0,0 +1,172 @@
+#include "RasterRenderer.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+  // 3x5 pixel font for the coordinate labels (a-h, then 1-8), one row per
+  // entry with the leftmost pixel in bit 2
+  const unsigned char labelPatterns[16][5] = {
+    {2, 5, 7, 5, 5},  // a
+    {6, 5, 6, 5, 6},  // b
+    {3, 4, 4, 4, 3},  // c
+    {6, 5, 5, 5, 6},  // d
+    {7, 4, 6, 4, 7},  // e
+    {7, 4, 6, 4, 4},  // f
+    {3, 4, 5, 5, 3},  // g
+    {5, 5, 7, 5, 5},  // h
+    {2, 6, 2, 2, 7},  // 1
+    {6, 1, 2, 4, 7},  // 2
+    {6, 1, 2, 1, 6},  // 3
+    {5, 5, 7, 1, 1},  // 4
+    {7, 4, 6, 1, 6},  // 5
+    {3, 4, 6, 5, 2},  // 6
+    {7, 1, 2, 2, 2},  // 7
+    {2, 5, 2, 5, 2}   // 8
+  };
+
+  // Each label pixel is drawn as a 2x2 block, roughly the size of the
+  // default X font the window uses
+  const int labelScale = 2;
+
+  void putBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+  }
+
+  // PNG chunk: length, type, data, CRC over type and data
+  void writeChunk(std::ofstream& out, const char* type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> chunk;
+    putBigEndian(chunk, static_cast<uint32_t>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    uLong crc = crc32(0L, chunk.data() + 4, static_cast<uInt>(chunk.size() - 4));
+    putBigEndian(chunk, static_cast<uint32_t>(crc));
+    out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+  }
+}
+
+RasterRenderer::RasterRenderer(int cellSize)
+  : Renderer{cellSize},
+    size{imageSize()},
+    image(static_cast<size_t>(size) * size * 3) {
+  fillRect(0, 0, size, size, backgroundColour);
+  drawBoardLabels();
+}
+
+const std::vector<unsigned char>& RasterRenderer::pixels() const {
+  return image;
+}
+
+void RasterRenderer::fillRect(int x, int y, int width, int height, unsigned long colour) {
+  unsigned char r = (colour >> 16) & 0xFF;
+  unsigned char g = (colour >> 8) & 0xFF;
+  unsigned char b = colour & 0xFF;
+  for (int row = y; row < y + height && row < size; ++row) {
+    unsigned char* pixel = &image[(static_cast<size_t>(row) * size + x) * 3];
+    for (int col = x; col < x + width && col < size; ++col) {
+      *pixel++ = r;
+      *pixel++ = g;
+      *pixel++ = b;
+    }
+  }
+}
+
+// Draw one label character with its baseline at y, like XDrawString
+void RasterRenderer::drawLabel(int x, int y, char label) {
+  int index = (label >= 'a' && label <= 'h') ? label - 'a' : label - '1' + 8;
+  int top = y - 5 * labelScale;
+  for (int row = 0; row < 5; ++row) {
+    for (int col = 0; col < 3; ++col) {
+      if (labelPatterns[index][row] & (4 >> col)) {
+        fillRect(x + col * labelScale, top + row * labelScale, labelScale, labelScale, textColour);
+      }
+    }
+  }
+}
+
+// Same label positions as the X11 window
+void RasterRenderer::drawBoardLabels() {
+  int cell = cellSize();
+  for (int file = 0; file < 8; ++file) {
+    drawLabel(file * cell + cell / 2 + margin, 8 * cell + 35, 'a' + file);
+  }
+  for (int rank = 0; rank < 8; ++rank) {
+    int y = (7 - rank) * cell + cell / 2 + margin;
+    drawLabel(10, y, '1' + rank);
+    drawLabel(8 * cell + 30, y, '1' + rank);
+  }
+}
+
+void RasterRenderer::drawSquare(int x, int y, bool light, Highlight highlight, char symbol) {
+  int cell = cellSize();
+  fillRect(x, y, cell, cell, squareColour(light, highlight));
+
+  int count = 0;
+  const GlyphRect* glyph = glyphRects(symbol, count);
+  unsigned long colour = pieceColour(symbol);
+  for (int i = 0; i < count; ++i) {
+    fillRect(x + glyph[i].x, y + glyph[i].y, glyph[i].width, glyph[i].height, colour);
+  }
+}
+
+// The image is the output; there is no separate surface to copy to
+void RasterRenderer::present(int, int, int, int) {}
+
+bool RasterRenderer::writePPM(const std::string& path) const {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) return false;
+  out << "P6\n" << size << " " << size << "\n255\n";
+  out.write(reinterpret_cast<const char*>(image.data()), image.size());
+  return static_cast<bool>(out);
+}
+
+bool RasterRenderer::writePNG(const std::string& path) const {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) return false;
+
+  // Every scanline is prefixed with its filter type; 0 = none
+  size_t stride = static_cast<size_t>(size) * 3;
+  std::vector<unsigned char> raw;
+  raw.reserve((stride + 1) * size);
+  for (int row = 0; row < size; ++row) {
+    raw.push_back(0);
+    raw.insert(raw.end(), image.begin() + row * stride, image.begin() + (row + 1) * stride);
+  }
+
+  uLongf compressedSize = compressBound(raw.size());
+  std::vector<unsigned char> compressed(compressedSize);
+  if (compress2(compressed.data(), &compressedSize, raw.data(), raw.size(), Z_BEST_SPEED) != Z_OK) {
+    return false;
+  }
+  compressed.resize(compressedSize);
+
+  // IHDR: width, height, 8 bits per channel, RGB, default compression,
+  // filtering and no interlace
+  std::vector<unsigned char> header;
+  putBigEndian(header, size);
+  putBigEndian(header, size);
+  header.push_back(8);
+  header.push_back(2);
+  header.push_back(0);
+  header.push_back(0);
+  header.push_back(0);
+
+  const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  out.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+  writeChunk(out, "IHDR", header);
+  writeChunk(out, "IDAT", compressed);
+  writeChunk(out, "IEND", {});
+  return static_cast<bool>(out);
+}
+
+bool RasterRenderer::save(const std::string& path) const {
+  if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".ppm") == 0) {
+    return writePPM(path);
+  }
+  return writePNG(path);
+}
@@ -0,0 +1,35 @@
+#ifndef RASTER_RENDERER_H
+#define RASTER_RENDERER_H
+
+#include "Renderer.h"
+#include <string>
+#include <vector>
+
+// Renders into an RGB image in memory; needs no X server, so it works
+// headless and one instance per thread can thumbnail positions in parallel.
+// The image is laid out exactly like the X11 window.
+class RasterRenderer : public Renderer {
+public:
+  explicit RasterRenderer(int cellSize);
+
+  const std::vector<unsigned char>& pixels() const;  // RGB, row-major
+
+  bool writePPM(const std::string& path) const;
+  bool writePNG(const std::string& path) const;
+  // Picks the format from the extension (.ppm, otherwise PNG)
+  bool save(const std::string& path) const;
+
+protected:
+  void drawSquare(int x, int y, bool light, Highlight highlight, char symbol) override;
+  void present(int x, int y, int width, int height) override;
+
+private:
+  int size;
+  std::vector<unsigned char> image;
+
+  void fillRect(int x, int y, int width, int height, unsigned long colour);
+  void drawLabel(int x, int y, char label);
+  void drawBoardLabels();
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "Renderer.h"
+#include "Board.h"
+#include "Piece.h"
+#include "Pos.h"
+#include <algorithm>
+
+namespace {
+  // Simple pixelated letters (1 = pixel, 0 = empty), classic 5x7 pixel font
+  // patterns in the order P N B R Q K
+  const int letterPatterns[6][7][5] = {
+    { // P
+      {1,1,1,1,0},
+      {1,0,0,0,1},
+      {1,0,0,0,1},
+      {1,1,1,1,0},
+      {1,0,0,0,0},
+      {1,0,0,0,0},
+      {1,0,0,0,0}
+    },
+    { // N
+      {1,0,0,0,1},
+      {1,1,0,0,1},
+      {1,0,1,0,1},
+      {1,0,0,1,1},
+      {1,0,0,0,1},
+      {1,0,0,0,1},
+      {1,0,0,0,1}
+    },
+    { // B
+      {1,1,1,1,0},
+      {1,0,0,0,1},
+      {1,0,0,0,1},
+      {1,1,1,1,0},
+      {1,0,0,0,1},
+      {1,0,0,0,1},
+      {1,1,1,1,0}
+    },
+    { // R
+      {1,1,1,1,0},
+      {1,0,0,0,1},
+      {1,0,0,0,1},
+      {1,1,1,1,0},
+      {1,0,1,0,0},
+      {1,0,0,1,0},
+      {1,0,0,0,1}
+    },
+    { // Q
+      {0,1,1,1,0},
+      {1,0,0,0,1},
+      {1,0,0,0,1},
+      {1,0,0,0,1},
+      {1,0,1,0,1},
+      {1,0,0,1,0},
+      {0,1,1,0,1}
+    },
+    { // K
+      {1,0,0,0,1},
+      {1,0,0,1,0},
+      {1,0,1,0,0},
+      {1,1,0,0,0},
+      {1,0,1,0,0},
+      {1,0,0,1,0},
+      {1,0,0,0,1}
+    }
+  };
+}
+
+Renderer::Renderer(int cellSize)
+  : cell{cellSize}, drawnSquares{}, highlights{}, drawnHighlights{}, glyphs{}, glyphCount{} {
+  buildGlyphRects();
+}
+
+Renderer::~Renderer() {}
+
+int Renderer::cellSize() const {
+  return cell;
+}
+
+int Renderer::imageSize() const {
+  return cell * 8 + 2 * margin;
+}
+
+void Renderer::invalidate() {
+  for (int rank = 0; rank < 8; ++rank) {
+    for (int file = 0; file < 8; ++file) {
+      drawnSquares[rank][file] = '\0';
+    }
+  }
+}
+
+void Renderer::setHighlight(Pos square, Highlight highlight) {
+  highlights[square.rank][square.file] = highlight;
+}
+
+void Renderer::clearHighlights() {
+  for (int rank = 0; rank < 8; ++rank) {
+    for (int file = 0; file < 8; ++file) {
+      highlights[rank][file] = Highlight::None;
+    }
+  }
+}
+
+bool Renderer::squareAt(int x, int y, Pos& square) const {
+  int file = (x - margin) / cell;
+  int rank = 7 - (y - margin) / cell;
+  if (x < margin || y < margin || file > 7 || rank < 0) return false;
+  square = {file, rank};
+  return true;
+}
+
+unsigned long Renderer::squareColour(bool light, Highlight highlight) {
+  switch (highlight) {
+    case Highlight::Selected:
+      return selectedSquareColour;
+    case Highlight::Destination:
+      return destinationSquareColour;
+    default:
+      return light ? lightSquareColour : darkSquareColour;
+  }
+}
+
+// Build the filled rectangles for each piece letter at the current cell size.
+// Runs of lit pixels in a row are merged into one rectangle.
+void Renderer::buildGlyphRects() {
+  // Size of each pixel block
+  int pixelSize = cell / 10;
+
+  int offsetX = (cell - pixelSize * 5) / 2;
+  int offsetY = (cell - pixelSize * 7) / 2;
+
+  for (int type = 0; type < 6; ++type) {
+    int count = 0;
+    for (int row = 0; row < 7; row++) {
+      int col = 0;
+      while (col < 5) {
+        if (letterPatterns[type][row][col] != 1) {
+          ++col;
+          continue;
+        }
+        int runStart = col;
+        while (col < 5 && letterPatterns[type][row][col] == 1) ++col;
+
+        GlyphRect& rect = glyphs[type][count++];
+        rect.x = offsetX + runStart * pixelSize;
+        rect.y = offsetY + row * pixelSize;
+        rect.width = (col - runStart) * pixelSize;
+        rect.height = pixelSize;
+      }
+    }
+    glyphCount[type] = count;
+  }
+}
+
+// Index of a piece symbol in glyphSymbols; 12 is the empty square
+int Renderer::glyphIndex(char symbol) {
+  for (int i = 0; i < 12; ++i) {
+    if (glyphSymbols[i] == symbol) return i;
+  }
+  return 12;
+}
+
+const Renderer::GlyphRect* Renderer::glyphRects(char symbol, int& count) const {
+  int index = glyphIndex(symbol);
+  if (index == 12) {
+    count = 0;
+    return nullptr;
+  }
+  // Both colours share the letter shape
+  int type = index % 6;
+  count = glyphCount[type];
+  return glyphs[type];
+}
+
+unsigned long Renderer::pieceColour(char symbol) {
+  bool isWhitePiece = (symbol >= 'A' && symbol <= 'Z');
+  return isWhitePiece ? whitePieceColour : blackPieceColour;
+}
+
+// Repaint squares whose contents changed since the last render, then present
+// the changed area (or the whole image) in one go
+void Renderer::render(const Board& board, bool fullRefresh) {
+  int minX = 0, minY = 0, maxX = -1, maxY = -1;
+
+  for (int rank = 0; rank < 8; ++rank) {
+    for (int file = 0; file < 8; ++file) {
+      auto piece = board.pieceAt({file, rank});
+      char symbol = piece ? piece->symbol() : '.';
+      Highlight highlight = highlights[rank][file];
+      if (drawnSquares[rank][file] == symbol && drawnHighlights[rank][file] == highlight) continue;
+      drawnSquares[rank][file] = symbol;
+      drawnHighlights[rank][file] = highlight;
+
+      // Calculate position with offset for coordinates
+      int x = file * cell + margin;  // Offset for rank numbers on left
+      int y = (7 - rank) * cell + margin;  // Offset for file letters on bottom
+
+      drawSquare(x, y, (rank + file) % 2 == 0, highlight, symbol);
+
+      if (maxX < 0) {
+        minX = x;
+        minY = y;
+        maxX = x + cell;
+        maxY = y + cell;
+      } else {
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x + cell);
+        maxY = std::max(maxY, y + cell);
+      }
+    }
+  }
+
+  if (fullRefresh) {
+    present(0, 0, imageSize(), imageSize());
+  } else if (maxX >= 0) {
+    present(minX, minY, maxX - minX, maxY - minY);
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "Board.h"
+#include "Pos.h"
+
+// Draws the board with the pixel-font piece letters. The base class lays out
+// the squares and remembers what is already drawn, so backends only repaint
+// squares whose contents changed. Backends: X11Renderer (window) and
+// RasterRenderer (in-memory image, no X server needed).
+class Renderer {
+public:
+  explicit Renderer(int cellSize);
+  virtual ~Renderer();
+  Renderer(const Renderer&) = delete;
+  Renderer& operator=(const Renderer&) = delete;
+
+  // Repaints changed squares and presents them; fullRefresh presents the
+  // whole image even when nothing changed (e.g. after an expose)
+  void render(const Board& board, bool fullRefresh = false);
+  // Forgets what has been drawn so the next render repaints every square
+  void invalidate();
+
+  // Square overlays, shown from the next render on
+  enum class Highlight : char { None, Selected, Destination };
+  void setHighlight(Pos square, Highlight highlight);
+  void clearHighlights();
+
+  // Board square under pixel (x, y); false in the margin
+  bool squareAt(int x, int y, Pos& square) const;
+
+  int cellSize() const;
+  int imageSize() const;  // board plus the coordinate margin, in pixels
+
+protected:
+  // One filled rectangle of a piece letter, relative to its square
+  struct GlyphRect {
+    int x;
+    int y;
+    int width;
+    int height;
+  };
+
+  static constexpr int margin = 20;
+  static constexpr unsigned long backgroundColour = 0xD2B48C;
+  static constexpr unsigned long lightSquareColour = 0xF0D9B5;
+  static constexpr unsigned long darkSquareColour = 0xB58863;
+  static constexpr unsigned long selectedSquareColour = 0xF6F669;
+  static constexpr unsigned long destinationSquareColour = 0xA9C97B;
+  static constexpr unsigned long whitePieceColour = 0xFFFFFF;
+  static constexpr unsigned long blackPieceColour = 0x000000;
+  static constexpr unsigned long textColour = 0x000000;
+
+  static constexpr const char* glyphSymbols = "PNBRQKpnbrqk";
+  static int glyphIndex(char symbol);  // 12 for an empty square
+
+  // Rectangles of the letter for symbol; count is 0 for an empty square
+  const GlyphRect* glyphRects(char symbol, int& count) const;
+  static unsigned long pieceColour(char symbol);
+
+  // Background colour of a square, highlight taking precedence
+  static unsigned long squareColour(bool light, Highlight highlight);
+
+  // Paints the square whose top-left corner is (x, y)
+  virtual void drawSquare(int x, int y, bool light, Highlight highlight, char symbol) = 0;
+  // Makes the given area of the image visible
+  virtual void present(int x, int y, int width, int height) = 0;
+
+private:
+  int cell;
+  char drawnSquares[8][8];  // symbol currently drawn per square, '\0' = nothing
+  Highlight highlights[8][8];
+  Highlight drawnHighlights[8][8];
+  GlyphRect glyphs[6][35];  // per piece letter (P N B R Q K)
+  int glyphCount[6];
+
+  void buildGlyphRects();
+};
+
+#endif
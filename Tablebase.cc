@@ -0,0 +1,715 @@
+#include "Tablebase.h"
+#include "Board.h"
+#include "Colour.h"
+#include "Pos.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  const unsigned char Draw = 0;
+  const unsigned char LossBase = 128;
+  const unsigned char Illegal = 255;
+  const int MaxDepth = 126;
+
+  const char fileMagic[8] = {'C', '2', '4', '6', 'T', 'B', '0', '1'};
+  const size_t headerSize = 16;
+  const std::string pieceOrder = "QRBNP";
+
+  bool isWin(unsigned char v) { return v >= 1 && v < LossBase; }
+  bool isLoss(unsigned char v) { return v >= LossBase && v != Illegal; }
+
+  // sq[0] is the white (strong side) king, sq[1] the lone black king and
+  // sq[2..count) the extra white pieces described by type[]
+  struct TbPos {
+    int sq[4];
+    char type[4];
+    int count;
+    bool whiteToMove;
+  };
+
+  int fileOf(int s) { return s & 7; }
+  int rankOf(int s) { return s >> 3; }
+  int square(int file, int rank) { return rank * 8 + file; }
+  bool onBoard(int file, int rank) { return file >= 0 && file < 8 && rank >= 0 && rank < 8; }
+
+  const int kingSteps[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+  const int knightSteps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+  const int diagonals[4][2] = {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+  const int orthogonals[4][2] = {{1, 0}, {0, -1}, {-1, 0}, {0, 1}};
+
+  bool hasPawn(const std::string& extras) {
+    return extras.find('P') != std::string::npos;
+  }
+
+  bool insufficient(const std::string& extras) {
+    return extras.empty() || extras == "B" || extras == "N";
+  }
+
+  std::string tableName(const std::string& extras) {
+    return "K" + extras + "K";
+  }
+
+  std::string normalise(std::string extras) {
+    std::sort(extras.begin(), extras.end(), [](char a, char b) {
+      return pieceOrder.find(a) < pieceOrder.find(b);
+    });
+    return extras;
+  }
+
+  std::string extrasOf(const TbPos& p) {
+    return std::string(p.type + 2, p.type + p.count);
+  }
+
+  // Keeps the extra pieces in table order so positions index consistently
+  void sortExtras(TbPos& p) {
+    for (int i = 3; i < p.count; ++i) {
+      for (int j = i; j > 2 && pieceOrder.find(p.type[j]) < pieceOrder.find(p.type[j - 1]); --j) {
+        std::swap(p.type[j], p.type[j - 1]);
+        std::swap(p.sq[j], p.sq[j - 1]);
+      }
+    }
+  }
+
+  // Pawnless tables keep the white king in the a1-d1-d4 triangle, tables
+  // with pawns only use the left/right mirror
+  int kingSlots(bool pawns) {
+    return pawns ? 32 : 10;
+  }
+
+  int kingSlot(int s, bool pawns) {
+    int file = fileOf(s);
+    int rank = rankOf(s);
+    if (pawns) return rank * 4 + file;
+    int slot = 0;
+    for (int r = 0; r < 4; ++r) {
+      for (int f = r; f < 4; ++f) {
+        if (f == file && r == rank) return slot;
+        ++slot;
+      }
+    }
+    return -1;
+  }
+
+  int slotSquare(int slot, bool pawns) {
+    if (pawns) return square(slot % 4, slot / 4);
+    for (int r = 0; r < 4; ++r) {
+      for (int f = r; f < 4; ++f) {
+        if (slot-- == 0) return square(f, r);
+      }
+    }
+    return -1;
+  }
+
+  // Identical pieces are ordered by square so each position has one index
+  void orderTwins(TbPos& p) {
+    for (int i = 3; i < p.count; ++i) {
+      if (p.type[i] == p.type[i - 1] && p.sq[i] < p.sq[i - 1]) std::swap(p.sq[i], p.sq[i - 1]);
+    }
+  }
+
+  void transpose(TbPos& p) {
+    for (int i = 0; i < p.count; ++i) p.sq[i] = square(rankOf(p.sq[i]), fileOf(p.sq[i]));
+  }
+
+  void canonicalise(TbPos& p, bool pawns) {
+    if (fileOf(p.sq[0]) > 3) {
+      for (int i = 0; i < p.count; ++i) p.sq[i] = square(7 - fileOf(p.sq[i]), rankOf(p.sq[i]));
+    }
+    if (!pawns) {
+      if (rankOf(p.sq[0]) > 3) {
+        for (int i = 0; i < p.count; ++i) p.sq[i] = square(fileOf(p.sq[i]), 7 - rankOf(p.sq[i]));
+      }
+      if (rankOf(p.sq[0]) > fileOf(p.sq[0])) transpose(p);
+    }
+    orderTwins(p);
+
+    // With the king on the a1-h8 diagonal the transposed position is the
+    // same one, so keep whichever of the two sorts first
+    if (!pawns && rankOf(p.sq[0]) == fileOf(p.sq[0])) {
+      TbPos flipped = p;
+      transpose(flipped);
+      orderTwins(flipped);
+      for (int i = 1; i < p.count; ++i) {
+        if (flipped.sq[i] != p.sq[i]) {
+          if (flipped.sq[i] < p.sq[i]) p = flipped;
+          break;
+        }
+      }
+    }
+  }
+
+  size_t entryCount(const std::string& extras) {
+    size_t n = 2 * kingSlots(hasPawn(extras)) * 64;
+    for (size_t i = 0; i < extras.size(); ++i) n *= 64;
+    return n;
+  }
+
+  size_t indexOf(TbPos p, bool pawns) {
+    canonicalise(p, pawns);
+    size_t index = (p.whiteToMove ? 1 : 0) * kingSlots(pawns) + kingSlot(p.sq[0], pawns);
+    for (int i = 1; i < p.count; ++i) {
+      index = index * 64 + p.sq[i];
+    }
+    return index;
+  }
+
+  TbPos decode(size_t index, const std::string& extras) {
+    bool pawns = hasPawn(extras);
+    TbPos p;
+    p.count = 2 + static_cast<int>(extras.size());
+    p.type[0] = 'K';
+    p.type[1] = 'k';
+    for (int i = p.count - 1; i >= 1; --i) {
+      p.sq[i] = static_cast<int>(index % 64);
+      index /= 64;
+      if (i >= 2) p.type[i] = extras[i - 2];
+    }
+    int slots = kingSlots(pawns);
+    p.sq[0] = slotSquare(static_cast<int>(index % slots), pawns);
+    p.whiteToMove = (index / slots) == 1;
+    return p;
+  }
+
+  uint64_t occupancy(const TbPos& p) {
+    uint64_t occ = 0;
+    for (int i = 0; i < p.count; ++i) occ |= 1ULL << p.sq[i];
+    return occ;
+  }
+
+  bool rayClear(int from, int to, uint64_t occ) {
+    int df = (fileOf(to) > fileOf(from)) - (fileOf(to) < fileOf(from));
+    int dr = (rankOf(to) > rankOf(from)) - (rankOf(to) < rankOf(from));
+    int f = fileOf(from) + df;
+    int r = rankOf(from) + dr;
+    while (square(f, r) != to) {
+      if (occ & (1ULL << square(f, r))) return false;
+      f += df;
+      r += dr;
+    }
+    return true;
+  }
+
+  bool attacks(char type, int from, int to, uint64_t occ) {
+    int df = std::abs(fileOf(to) - fileOf(from));
+    int dr = std::abs(rankOf(to) - rankOf(from));
+    if (from == to) return false;
+    switch (type) {
+      case 'K': return df <= 1 && dr <= 1;
+      case 'N': return (df == 1 && dr == 2) || (df == 2 && dr == 1);
+      case 'P': return df == 1 && rankOf(to) - rankOf(from) == 1;
+      case 'B': return df == dr && rayClear(from, to, occ);
+      case 'R': return (df == 0 || dr == 0) && rayClear(from, to, occ);
+      case 'Q': return (df == dr || df == 0 || dr == 0) && rayClear(from, to, occ);
+      default: return false;
+    }
+  }
+
+  bool whiteAttacks(const TbPos& p, int target, uint64_t occ) {
+    for (int i = 0; i < p.count; ++i) {
+      if (i == 1) continue;
+      if (attacks(p.type[i], p.sq[i], target, occ)) return true;
+    }
+    return false;
+  }
+
+  bool kingsTouch(const TbPos& p) {
+    return std::abs(fileOf(p.sq[0]) - fileOf(p.sq[1])) <= 1 &&
+           std::abs(rankOf(p.sq[0]) - rankOf(p.sq[1])) <= 1;
+  }
+
+  bool isLegal(const TbPos& p) {
+    for (int i = 0; i < p.count; ++i) {
+      for (int j = i + 1; j < p.count; ++j) {
+        if (p.sq[i] == p.sq[j]) return false;
+      }
+      if (p.type[i] == 'P' && (rankOf(p.sq[i]) == 0 || rankOf(p.sq[i]) == 7)) return false;
+    }
+    if (kingsTouch(p)) return false;
+    if (p.whiteToMove && whiteAttacks(p, p.sq[1], occupancy(p))) return false;
+    return true;
+  }
+
+  // Calls visit(child, leavesTable) for every legal move. Moves that capture
+  // or promote change the material and are looked up in another table.
+  template <typename Visit>
+  void forEachMove(const TbPos& p, Visit visit) {
+    uint64_t occ = occupancy(p);
+
+    if (!p.whiteToMove) {
+      for (const auto& step : kingSteps) {
+        int f = fileOf(p.sq[1]) + step[0];
+        int r = rankOf(p.sq[1]) + step[1];
+        if (!onBoard(f, r)) continue;
+
+        TbPos child = p;
+        child.sq[1] = square(f, r);
+        child.whiteToMove = true;
+        if (kingsTouch(child)) continue;
+
+        bool capture = false;
+        for (int j = 2; j < child.count; ++j) {
+          if (child.sq[j] == child.sq[1]) {
+            for (int k = j; k + 1 < child.count; ++k) {
+              child.sq[k] = child.sq[k + 1];
+              child.type[k] = child.type[k + 1];
+            }
+            --child.count;
+            capture = true;
+            break;
+          }
+        }
+
+        if (whiteAttacks(child, child.sq[1], occupancy(child))) continue;
+        visit(child, capture);
+      }
+      return;
+    }
+
+    for (int i = 0; i < p.count; ++i) {
+      if (i == 1) continue;
+      int from = p.sq[i];
+      char type = p.type[i];
+
+      auto tryMove = [&](int to, char newType) {
+        TbPos child = p;
+        child.sq[i] = to;
+        child.whiteToMove = false;
+        if (newType) child.type[i] = newType;
+        if (i == 0 && kingsTouch(child)) return;
+        if (newType) sortExtras(child);
+        visit(child, newType != 0);
+      };
+
+      if (type == 'K' || type == 'N') {
+        const int (*steps)[2] = (type == 'K') ? kingSteps : knightSteps;
+        for (int k = 0; k < 8; ++k) {
+          int f = fileOf(from) + steps[k][0];
+          int r = rankOf(from) + steps[k][1];
+          if (onBoard(f, r) && !(occ & (1ULL << square(f, r)))) tryMove(square(f, r), 0);
+        }
+      } else if (type == 'P') {
+        int one = from + 8;
+        if (occ & (1ULL << one)) continue;
+        if (rankOf(one) == 7) {
+          for (char promotion : {'Q', 'R', 'B', 'N'}) tryMove(one, promotion);
+        } else {
+          tryMove(one, 0);
+          if (rankOf(from) == 1 && !(occ & (1ULL << (one + 8)))) tryMove(one + 8, 0);
+        }
+      } else {
+        for (int d = 0; d < 8; ++d) {
+          const int* dir = (d < 4) ? diagonals[d] : orthogonals[d - 4];
+          if (type == 'B' && d >= 4) break;
+          if (type == 'R' && d < 4) continue;
+          int f = fileOf(from) + dir[0];
+          int r = rankOf(from) + dir[1];
+          while (onBoard(f, r) && !(occ & (1ULL << square(f, r)))) {
+            tryMove(square(f, r), 0);
+            f += dir[0];
+            r += dir[1];
+          }
+        }
+      }
+    }
+  }
+
+  // Calls visit(parent) for every legal position with the same material
+  // that reaches p in one move (no uncaptures or unpromotions)
+  template <typename Visit>
+  void forEachUnmove(const TbPos& p, Visit visit) {
+    uint64_t occ = occupancy(p);
+    auto empty = [occ](int f, int r) {
+      return onBoard(f, r) && !(occ & (1ULL << square(f, r)));
+    };
+
+    if (p.whiteToMove) {
+      for (const auto& step : kingSteps) {
+        int f = fileOf(p.sq[1]) + step[0];
+        int r = rankOf(p.sq[1]) + step[1];
+        if (!empty(f, r)) continue;
+        TbPos parent = p;
+        parent.sq[1] = square(f, r);
+        parent.whiteToMove = false;
+        if (isLegal(parent)) visit(parent);
+      }
+      return;
+    }
+
+    for (int i = 0; i < p.count; ++i) {
+      if (i == 1) continue;
+      int from = p.sq[i];
+      char type = p.type[i];
+
+      auto emit = [&](int f, int r) {
+        TbPos parent = p;
+        parent.sq[i] = square(f, r);
+        parent.whiteToMove = true;
+        if (isLegal(parent)) visit(parent);
+      };
+
+      if (type == 'K' || type == 'N') {
+        const int (*steps)[2] = (type == 'K') ? kingSteps : knightSteps;
+        for (int k = 0; k < 8; ++k) {
+          int f = fileOf(from) + steps[k][0];
+          int r = rankOf(from) + steps[k][1];
+          if (empty(f, r)) emit(f, r);
+        }
+      } else if (type == 'P') {
+        int f = fileOf(from);
+        int r = rankOf(from);
+        if (r >= 2 && empty(f, r - 1)) {
+          emit(f, r - 1);
+          if (r == 3 && empty(f, r - 2)) emit(f, r - 2);
+        }
+      } else {
+        for (int d = 0; d < 8; ++d) {
+          const int* dir = (d < 4) ? diagonals[d] : orthogonals[d - 4];
+          if (type == 'B' && d >= 4) break;
+          if (type == 'R' && d < 4) continue;
+          int f = fileOf(from) + dir[0];
+          int r = rankOf(from) + dir[1];
+          while (empty(f, r)) {
+            emit(f, r);
+            f += dir[0];
+            r += dir[1];
+          }
+        }
+      }
+    }
+  }
+
+  class Generator {
+  public:
+    explicit Generator(std::ostream& log) : log{log} {}
+
+    bool build(const std::string& extras, const std::string& directory) {
+      if (insufficient(extras) || built.count(extras)) return true;
+
+      // Tables reached by captures and promotions have to exist first
+      for (size_t i = 0; i < extras.size(); ++i) {
+        std::string rest = extras;
+        rest.erase(i, 1);
+        if (!build(normalise(rest), directory)) return false;
+        if (extras[i] == 'P') {
+          for (char promotion : {'Q', 'R', 'B', 'N'}) {
+            std::string promoted = extras;
+            promoted[i] = promotion;
+            if (!build(normalise(promoted), directory)) return false;
+          }
+        }
+      }
+
+      std::vector<unsigned char>& values = built[extras];
+      int longest = solve(extras, values);
+
+      std::string path = directory + "/" + tableName(extras) + ".tb";
+      std::ofstream out(path, std::ios::binary);
+      char header[headerSize] = {};
+      std::memcpy(header, fileMagic, sizeof(fileMagic));
+      std::memcpy(header + 8, tableName(extras).c_str(), tableName(extras).size());
+      out.write(header, headerSize);
+      out.write(reinterpret_cast<const char*>(values.data()), values.size());
+      if (!out) {
+        log << "Could not write " << path << "\n";
+        return false;
+      }
+
+      log << tableName(extras) << ": " << values.size() << " positions, longest mate "
+          << longest << " plies\n";
+      return true;
+    }
+
+  private:
+    std::ostream& log;
+    std::map<std::string, std::vector<unsigned char>> built;
+
+    unsigned char exitValue(TbPos child) const {
+      std::string extras = extrasOf(child);
+      if (insufficient(extras)) return Draw;
+      sortExtras(child);
+      const std::vector<unsigned char>& table = built.at(extras);
+      return table[indexOf(child, hasPawn(extras))];
+    }
+
+    // A black position is lost once every move runs into a white win
+    // already settled at depth d or less
+    bool defenderLost(const TbPos& p, const std::vector<unsigned char>& values,
+                      bool pawns, int d, int& longest) const {
+      bool lost = true;
+      int moves = 0;
+      longest = 0;
+      forEachMove(p, [&](const TbPos& child, bool leaves) {
+        if (!lost) return;
+        ++moves;
+        unsigned char v = leaves ? exitValue(child) : values[indexOf(child, pawns)];
+        if (!isWin(v) || (!leaves && v > d)) {
+          lost = false;
+          return;
+        }
+        longest = std::max(longest, static_cast<int>(v));
+      });
+      return lost && moves > 0;
+    }
+
+    int solve(const std::string& extras, std::vector<unsigned char>& values) {
+      bool pawns = hasPawn(extras);
+      size_t entries = entryCount(extras);
+      values.assign(entries, Illegal);
+      int maxDepth = 0;
+
+      // Terminal positions and moves that leave the table
+      for (size_t index = 0; index < entries; ++index) {
+        TbPos p = decode(index, extras);
+        if (!isLegal(p) || indexOf(p, pawns) != index) continue;
+        values[index] = Draw;
+
+        int moves = 0;
+        int inTable = 0;
+        int bestExit = 0;
+        forEachMove(p, [&](const TbPos& child, bool leaves) {
+          ++moves;
+          if (!leaves) {
+            ++inTable;
+          } else if (p.whiteToMove) {
+            unsigned char v = exitValue(child);
+            if (isLoss(v)) {
+              int depth = v - LossBase + 1;
+              if (!bestExit || depth < bestExit) bestExit = depth;
+            }
+          }
+        });
+
+        if (moves == 0) {
+          if (!p.whiteToMove && whiteAttacks(p, p.sq[1], occupancy(p))) {
+            values[index] = LossBase;
+          }
+        } else if (p.whiteToMove && bestExit && bestExit <= MaxDepth) {
+          values[index] = static_cast<unsigned char>(bestExit);
+          maxDepth = std::max(maxDepth, bestExit);
+        } else if (!p.whiteToMove && inTable == 0) {
+          int longest;
+          if (defenderLost(p, values, pawns, MaxDepth, longest) && longest < MaxDepth) {
+            values[index] = static_cast<unsigned char>(LossBase + longest + 1);
+            maxDepth = std::max(maxDepth, longest + 1);
+          }
+        }
+      }
+
+      // Retrograde passes: losses at depth d make their parents wins at
+      // d + 1, and settled wins may complete a parent's forced loss
+      for (int d = 0; d <= maxDepth && d < MaxDepth; ++d) {
+        for (size_t index = 0; index < entries; ++index) {
+          unsigned char v = values[index];
+          if (v == LossBase + d) {
+            forEachUnmove(decode(index, extras), [&](const TbPos& parent) {
+              unsigned char& pv = values[indexOf(parent, pawns)];
+              if (pv == Draw || (isWin(pv) && pv > d + 1)) {
+                pv = static_cast<unsigned char>(d + 1);
+                maxDepth = std::max(maxDepth, d + 1);
+              }
+            });
+          } else if (d > 0 && v == d) {
+            forEachUnmove(decode(index, extras), [&](const TbPos& parent) {
+              unsigned char& pv = values[indexOf(parent, pawns)];
+              int longest;
+              if (pv == Draw && defenderLost(parent, values, pawns, d, longest) &&
+                  longest < MaxDepth) {
+                pv = static_cast<unsigned char>(LossBase + longest + 1);
+                maxDepth = std::max(maxDepth, longest + 1);
+              }
+            });
+          }
+        }
+      }
+
+      return maxDepth;
+    }
+  };
+}
+
+Tablebase::Tablebase() {}
+
+Tablebase::~Tablebase() {
+  close();
+}
+
+std::vector<std::string> Tablebase::defaultMaterials() {
+  return {"KQK", "KRK", "KPK", "KBNK"};
+}
+
+bool Tablebase::generate(const std::string& directory,
+                         const std::vector<std::string>& materials,
+                         std::ostream& log) {
+  Generator generator(log);
+
+  for (const auto& name : materials) {
+    bool valid = name.size() >= 3 && name.size() <= 2 + (MaxPieces - 2) &&
+                 name.front() == 'K' && name.back() == 'K';
+    std::string extras = valid ? name.substr(1, name.size() - 2) : "";
+    for (char c : extras) {
+      if (pieceOrder.find(c) == std::string::npos) valid = false;
+    }
+    if (!valid || extras.empty()) {
+      log << "Unsupported material: " << name << "\n";
+      return false;
+    }
+    if (!generator.build(normalise(extras), directory)) return false;
+  }
+
+  return true;
+}
+
+int Tablebase::open(const std::string& directory) {
+  close();
+
+  // Every combination of up to two extra pieces that is not a trivial draw
+  std::vector<std::string> candidates;
+  for (size_t i = 0; i < pieceOrder.size(); ++i) {
+    candidates.push_back(std::string(1, pieceOrder[i]));
+    for (size_t j = i; j < pieceOrder.size(); ++j) {
+      candidates.push_back(std::string(1, pieceOrder[i]) + pieceOrder[j]);
+    }
+  }
+
+  for (const auto& extras : candidates) {
+    if (insufficient(extras)) continue;
+
+    std::string path = directory + "/" + tableName(extras) + ".tb";
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) continue;
+
+    size_t entries = entryCount(extras);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != headerSize + entries) {
+      ::close(fd);
+      continue;
+    }
+
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) continue;
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(mapped);
+    if (std::memcmp(bytes, fileMagic, sizeof(fileMagic)) != 0) {
+      munmap(mapped, st.st_size);
+      continue;
+    }
+
+    tables.push_back({extras, bytes, static_cast<size_t>(st.st_size), bytes + headerSize, entries});
+  }
+
+  return static_cast<int>(tables.size());
+}
+
+void Tablebase::close() {
+  for (auto& table : tables) {
+    munmap(const_cast<unsigned char*>(table.mapping), table.length);
+  }
+  tables.clear();
+}
+
+bool Tablebase::isOpen() const {
+  return !tables.empty();
+}
+
+size_t Tablebase::tableCount() const {
+  return tables.size();
+}
+
+bool Tablebase::probe(const Board& board, TablebaseResult& result) const {
+  if (tables.empty()) return false;
+
+  // Collect kings and extra pieces for each side
+  int kings[2] = {-1, -1};
+  int extraSquares[2][MaxPieces];
+  char extraTypes[2][MaxPieces];
+  int extraCount[2] = {0, 0};
+  int total = 0;
+
+  for (int side = 0; side < 2; ++side) {
+    Colour colour = (side == 0) ? Colour::White : Colour::Black;
+    for (uint64_t own = board.occupied(colour); own; own &= own - 1) {
+      if (++total > MaxPieces) return false;
+
+      int sq = std::countr_zero(own);
+      char type = static_cast<char>(toupper(board.pieceAt({fileOf(sq), rankOf(sq)})->symbol()));
+      if (type == 'K') {
+        kings[side] = sq;
+      } else {
+        extraSquares[side][extraCount[side]] = sq;
+        extraTypes[side][extraCount[side]] = type;
+        ++extraCount[side];
+      }
+    }
+  }
+
+  if (kings[0] < 0 || kings[1] < 0) return false;
+  if (extraCount[0] > 0 && extraCount[1] > 0) return false;
+
+  // Tables always have White as the strong side; mirror ranks otherwise
+  int strong = (extraCount[1] > 0) ? 1 : 0;
+  Colour strongColour = strong == 0 ? Colour::White : Colour::Black;
+  auto orient = [strong](int s) {
+    return strong == 0 ? s : square(fileOf(s), 7 - rankOf(s));
+  };
+
+  // The tables know nothing about castling
+  int homeRank = strong == 0 ? 0 : 7;
+  if (kings[strong] == square(4, homeRank) && !board.hasKingMoved(strongColour)) {
+    for (int i = 0; i < extraCount[strong]; ++i) {
+      if (extraTypes[strong][i] != 'R') continue;
+      if ((extraSquares[strong][i] == square(7, homeRank) && !board.hasRookMoved(strongColour, true)) ||
+          (extraSquares[strong][i] == square(0, homeRank) && !board.hasRookMoved(strongColour, false))) {
+        return false;
+      }
+    }
+  }
+
+  TbPos p;
+  p.sq[0] = orient(kings[strong]);
+  p.sq[1] = orient(kings[1 - strong]);
+  p.type[0] = 'K';
+  p.type[1] = 'k';
+  p.count = 2 + extraCount[strong];
+  for (int i = 0; i < extraCount[strong]; ++i) {
+    p.sq[2 + i] = orient(extraSquares[strong][i]);
+    p.type[2 + i] = extraTypes[strong][i];
+  }
+  p.whiteToMove = board.getCurrentTurn() == strongColour;
+  sortExtras(p);
+
+  std::string extras = extrasOf(p);
+  if (insufficient(extras)) {
+    result = {0, 0};
+    return true;
+  }
+
+  for (const auto& table : tables) {
+    if (table.extras != extras) continue;
+
+    unsigned char v = table.values[indexOf(p, hasPawn(extras))];
+    if (v == Illegal) return false;
+    if (isWin(v)) {
+      result = {1, v};
+    } else if (isLoss(v)) {
+      result = {-1, v - LossBase};
+    } else {
+      result = {0, 0};
+    }
+    return true;
+  }
+
+  return false;
+}
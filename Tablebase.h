@@ -0,0 +1,55 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include "Board.h"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Result of a tablebase probe from the side to move's point of view
+struct TablebaseResult {
+  int wdl;  // 1 = win, 0 = draw, -1 = loss
+  int dtm;  // plies to mate for wins and losses, 0 for draws
+};
+
+// Endgame tables for a lone king against a king plus up to two pieces
+// (KQK, KRK, KPK, KBNK, ...). Tables are built by retrograde analysis and
+// stored one byte per position: 0 draw, 1..127 win in that many plies,
+// 128 + n loss in n plies, 255 unreachable. Probing memory-maps the files.
+class Tablebase {
+public:
+  static const int MaxPieces = 4;
+
+  Tablebase();
+  ~Tablebase();
+  Tablebase(const Tablebase&) = delete;
+  Tablebase& operator=(const Tablebase&) = delete;
+
+  // Builds the named tables (e.g. "KQK") and everything they depend on
+  static bool generate(const std::string& directory,
+                       const std::vector<std::string>& materials,
+                       std::ostream& log);
+  static std::vector<std::string> defaultMaterials();
+
+  int open(const std::string& directory);
+  void close();
+  bool isOpen() const;
+  size_t tableCount() const;
+
+  // False when the position is outside the loaded tables
+  bool probe(const Board& board, TablebaseResult& result) const;
+
+private:
+  struct Table {
+    std::string extras;
+    const unsigned char* mapping;
+    size_t length;
+    const unsigned char* values;
+    size_t entries;
+  };
+
+  std::vector<Table> tables;
+};
+
+#endif
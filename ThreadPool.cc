@@ -0,0 +1,49 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+ThreadPool::ThreadPool(int threads) : stopping{false} {
+  threads = std::max(1, threads);
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([this]() { work(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  available.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+  available.notify_one();
+}
+
+int ThreadPool::size() const {
+  return static_cast<int>(workers.size());
+}
+
+void ThreadPool::work() {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      available.wait(lock, [this]() { return stopping || !jobs.empty(); });
+      if (jobs.empty()) return;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    job();
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running submitted jobs in FIFO order. The
+// destructor finishes the jobs already queued before joining the workers.
+class ThreadPool {
+public:
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void submit(std::function<void()> job);
+  int size() const;
+
+private:
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable available;
+  std::deque<std::function<void()>> jobs;
+  bool stopping;
+
+  void work();
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+namespace {
+  // Which pool and queue the current thread works for, if any
+  thread_local const WorkStealingPool* currentPool = nullptr;
+  thread_local int currentWorker = -1;
+
+  // Chunks per thread: enough for the stealing to even out uneven iterations
+  const size_t chunksPerThread = 4;
+}
+
+// One parallelFor call. remaining is guarded by mutex so the caller cannot
+// return (destroying the group) while a worker still signals it.
+struct WorkStealingPool::Group {
+  const std::function<void(size_t)>* body;
+  size_t remaining;
+  std::mutex mutex;
+  std::condition_variable done;
+};
+
+WorkStealingPool::WorkStealingPool(int threads) : queued{0}, nextQueue{0}, stopping{false} {
+  threads = std::max(0, threads);
+  for (int i = 0; i < threads; ++i) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([this, i]() { work(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  available.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+WorkStealingPool& WorkStealingPool::shared() {
+  static WorkStealingPool pool(static_cast<int>(std::thread::hardware_concurrency()) - 1);
+  return pool;
+}
+
+int WorkStealingPool::size() const {
+  return static_cast<int>(workers.size());
+}
+
+void WorkStealingPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+  if (count == 0) return;
+  if (queues.empty() || count == 1) {
+    for (size_t i = 0; i < count; ++i) {
+      body(i);
+    }
+    return;
+  }
+
+  size_t chunks = std::min(count, (queues.size() + 1) * chunksPerThread);
+  size_t chunkSize = (count + chunks - 1) / chunks;
+
+  Group group;
+  group.body = &body;
+  group.remaining = (count + chunkSize - 1) / chunkSize;
+
+  // A worker keeps its chunks in its own queue for the others to steal;
+  // outside callers spread them over all the queues
+  int home = (currentPool == this) ? currentWorker : -1;
+  size_t first = nextQueue.fetch_add(1);
+  size_t n = 0;
+  for (size_t begin = 0; begin < count; begin += chunkSize, ++n) {
+    size_t queue = (home >= 0) ? home : (first + n) % queues.size();
+    push(queue, Task{&group, begin, std::min(count, begin + chunkSize)});
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+  }
+  available.notify_all();
+
+  // Help until every chunk has run. Once no queue has a task left, all of
+  // this loop's chunks are running elsewhere and waiting is enough.
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(group.mutex);
+      if (group.remaining == 0) break;
+    }
+    Task task;
+    if (takeTask(home, task)) {
+      runTask(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(group.mutex);
+    group.done.wait(lock, [&group]() { return group.remaining == 0; });
+    break;
+  }
+}
+
+void WorkStealingPool::work(int index) {
+  currentPool = this;
+  currentWorker = index;
+
+  for (;;) {
+    Task task;
+    if (takeTask(index, task)) {
+      runTask(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    available.wait(lock, [this]() { return stopping || queued.load() > 0; });
+    if (stopping && queued.load() == 0) return;
+  }
+}
+
+void WorkStealingPool::push(size_t queue, const Task& task) {
+  std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+  queues[queue]->tasks.push_back(task);
+  ++queued;
+}
+
+// Newest task of the home queue first (its data is likely still in cache),
+// else the oldest task of another queue
+bool WorkStealingPool::takeTask(int home, Task& task) {
+  if (queued.load() == 0) return false;
+
+  if (home >= 0) {
+    Queue& own = *queues[home];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = own.tasks.back();
+      own.tasks.pop_back();
+      --queued;
+      return true;
+    }
+  }
+
+  size_t start = (home >= 0) ? home + 1 : 0;
+  for (size_t i = 0; i < queues.size(); ++i) {
+    Queue& victim = *queues[(start + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      --queued;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::runTask(const Task& task) {
+  Group& group = *task.group;
+  for (size_t i = task.begin; i < task.end; ++i) {
+    (*group.body)(i);
+  }
+
+  std::lock_guard<std::mutex> lock(group.mutex);
+  if (--group.remaining == 0) {
+    group.done.notify_all();
+  }
+}
@@ -0,0 +1,60 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs the iterations of a loop on a fixed set of workers. Every worker has
+// its own deque of chunks: it takes work from the back of its own and, once
+// that is empty, steals from the front of the others'. The thread calling
+// parallelFor helps until its loop is done, so loops may be started from
+// several threads at once (and from inside a worker) without deadlocking.
+class WorkStealingPool {
+public:
+  explicit WorkStealingPool(int threads);
+  ~WorkStealingPool();
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  // Call body(i) for every i in [0, count) and return once all have run.
+  // Iterations may run in any order and on any thread.
+  void parallelFor(size_t count, const std::function<void(size_t)>& body);
+  int size() const;
+
+  // Shared by the whole process: one worker per CPU besides the caller's
+  static WorkStealingPool& shared();
+
+private:
+  struct Group;
+  struct Task {
+    Group* group;
+    size_t begin;
+    size_t end;
+  };
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;  // one per worker
+  std::vector<std::thread> workers;
+  std::atomic<size_t> queued;                  // tasks in all queues
+  std::atomic<size_t> nextQueue;               // round robin for outside callers
+  std::mutex sleepMutex;
+  std::condition_variable available;
+  bool stopping;
+
+  void work(int index);
+  void push(size_t queue, const Task& task);
+  bool takeTask(int home, Task& task);
+  void runTask(const Task& task);
+};
+
+#endif
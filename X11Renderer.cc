@@ -0,0 +1,192 @@
+#include "X11Renderer.h"
+#include <iostream>
+
+X11Renderer::X11Renderer(int cellSize)
+  : Renderer{cellSize},
+    dpy{nullptr},
+    win{0},
+    gc{nullptr},
+    backBuffer{0},
+    squareGlyphs{} {}
+
+X11Renderer::~X11Renderer() {
+    close();
+}
+
+bool X11Renderer::open() {
+    // Open display
+    dpy = XOpenDisplay(nullptr);
+    if (!dpy) {
+        std::cerr << "Cannot open display" << std::endl;
+        return false;
+    }
+    
+    // Get default screen
+    int screen = DefaultScreen(dpy);
+    
+    // Window size includes padding for coordinates
+    int windowSize = imageSize();
+    int cell = cellSize();
+    
+    // Create window
+    win = XCreateSimpleWindow(
+        dpy,
+        RootWindow(dpy, screen),
+        100, 100,                      // position
+        windowSize, windowSize,        // size with padding
+        1,                             // border width
+        BlackPixel(dpy, screen),       // border color
+        backgroundColour               // background color (tan)
+    );
+    
+    // Set window title
+    XStoreName(dpy, win, "Chess");
+    
+    // Set window size hints to prevent resizing
+    XSizeHints sizeHints;
+    sizeHints.flags = PMinSize | PMaxSize;
+    sizeHints.min_width = windowSize;
+    sizeHints.min_height = windowSize;
+    sizeHints.max_width = windowSize;
+    sizeHints.max_height = windowSize;
+    XSetWMNormalHints(dpy, win, &sizeHints);
+    
+    // Select input events
+    XSelectInput(dpy, win, ExposureMask | ButtonPressMask | KeyPressMask);
+    
+    // Create graphics context
+    gc = XCreateGC(dpy, win, 0, nullptr);
+    
+    // Off-screen back buffer holding the whole window contents
+    int depth = DefaultDepth(dpy, screen);
+    backBuffer = XCreatePixmap(dpy, win, windowSize, windowSize, depth);
+    XSetForeground(dpy, gc, backgroundColour);
+    XFillRectangle(dpy, backBuffer, gc, 0, 0, windowSize, windowSize);
+    drawBoardLabels(backBuffer);
+    
+    // Pre-render every square once: each background (the two square colours
+    // and the two highlights), empty or holding one of the twelve pieces, so
+    // redrawing a square is a single copy
+    const unsigned long shades[4] = {
+        lightSquareColour, darkSquareColour, selectedSquareColour, destinationSquareColour
+    };
+    for (int shade = 0; shade < 4; ++shade) {
+        for (int glyph = 0; glyph < 13; ++glyph) {
+            Pixmap square = XCreatePixmap(dpy, win, cell, cell, depth);
+            XSetForeground(dpy, gc, shades[shade]);
+            XFillRectangle(dpy, square, gc, 0, 0, cell, cell);
+            if (glyph < 12) {
+                drawPieceSprite(square, 0, 0, glyphSymbols[glyph]);
+            }
+            squareGlyphs[shade][glyph] = square;
+        }
+    }
+    
+    // Nothing has been drawn into the back buffer yet
+    invalidate();
+    
+    // Map window
+    XMapWindow(dpy, win);
+    
+    // Force exposure event
+    XFlush(dpy);
+    
+    return true;
+}
+
+void X11Renderer::close() {
+    if (!dpy) return;
+    
+    for (int shade = 0; shade < 4; ++shade) {
+        for (int glyph = 0; glyph < 13; ++glyph) {
+            if (squareGlyphs[shade][glyph]) XFreePixmap(dpy, squareGlyphs[shade][glyph]);
+            squareGlyphs[shade][glyph] = 0;
+        }
+    }
+    if (backBuffer) XFreePixmap(dpy, backBuffer);
+    backBuffer = 0;
+    
+    if (gc) XFreeGC(dpy, gc);
+    gc = nullptr;
+    
+    XDestroyWindow(dpy, win);
+    win = 0;
+    XCloseDisplay(dpy);
+    dpy = nullptr;
+}
+
+Display* X11Renderer::display() const {
+    return dpy;
+}
+
+Window X11Renderer::window() const {
+    return win;
+}
+
+void X11Renderer::drawPieceSprite(Drawable target, int x, int y, char symbol) const {
+    int count = 0;
+    const GlyphRect* glyph = glyphRects(symbol, count);
+    if (!glyph) return; // Invalid symbol
+    
+    // Set appropriate color for the piece
+    XSetForeground(dpy, gc, pieceColour(symbol));
+    
+    // Shift the cached rectangles to this square and send them in one request
+    XRectangle rects[35];
+    for (int i = 0; i < count; ++i) {
+        rects[i].x = static_cast<short>(glyph[i].x + x);
+        rects[i].y = static_cast<short>(glyph[i].y + y);
+        rects[i].width = static_cast<unsigned short>(glyph[i].width);
+        rects[i].height = static_cast<unsigned short>(glyph[i].height);
+    }
+    XFillRectangles(dpy, target, gc, rects, count);
+}
+
+// Draw the coordinate labels around the board
+void X11Renderer::drawBoardLabels(Drawable target) const {
+  int cell = cellSize();
+  
+  // Draw file labels (a-h)
+  XSetForeground(dpy, gc, textColour);
+  for (int file = 0; file < 8; ++file) {
+      char label = 'a' + file;
+      
+      // Draw at bottom
+      XDrawString(dpy, target, gc,
+                  file * cell + cell/2 + margin,  // Add offset
+                  8 * cell + 35,  // Below the board
+                  &label, 1);
+  }
+  
+  // Draw rank labels (1-8)
+  for (int rank = 0; rank < 8; ++rank) {
+      char label = '1' + rank;
+      
+      // Draw at left side
+      XDrawString(dpy, target, gc,
+                  10,  // Left of the board
+                  (7 - rank) * cell + cell/2 + margin,  // Add offset
+                  &label, 1);
+      
+      XDrawString(dpy, target, gc,
+                  8 * cell + 30,
+                  (7 - rank) * cell + cell/2 + margin,
+                  &label, 1);
+  }
+}
+
+void X11Renderer::drawSquare(int x, int y, bool light, Highlight highlight, char symbol) {
+    int cell = cellSize();
+    int shade = light ? 0 : 1;
+    if (highlight == Highlight::Selected) shade = 2;
+    else if (highlight == Highlight::Destination) shade = 3;
+    XCopyArea(dpy, squareGlyphs[shade][glyphIndex(symbol)], backBuffer, gc,
+              0, 0, cell, cell, x, y);
+}
+
+void X11Renderer::present(int x, int y, int width, int height) {
+    XCopyArea(dpy, backBuffer, win, gc, x, y, width, height, x, y);
+    
+    // Flush all pending operations
+    XFlush(dpy);
+}
@@ -0,0 +1,38 @@
+#ifndef X11_RENDERER_H
+#define X11_RENDERER_H
+
+#include "Renderer.h"
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+// Renders into an X11 window through an off-screen back buffer. Every
+// square/piece combination is pre-rendered once, so repainting a square is
+// a single copy and presenting is one XCopyArea to the window.
+class X11Renderer : public Renderer {
+public:
+  explicit X11Renderer(int cellSize);
+  ~X11Renderer() override;
+
+  // Opens the display and maps the window; false if there is no X server
+  bool open();
+  void close();
+
+  Display* display() const;
+  Window window() const;
+
+protected:
+  void drawSquare(int x, int y, bool light, Highlight highlight, char symbol) override;
+  void present(int x, int y, int width, int height) override;
+
+private:
+  Display* dpy;
+  Window win;
+  GC gc;
+  Pixmap backBuffer;
+  Pixmap squareGlyphs[4][13];  // [light, dark, selected, destination][piece glyph, 12 = empty]
+
+  void drawPieceSprite(Drawable target, int x, int y, char symbol) const;
+  void drawBoardLabels(Drawable target) const;
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include "Pos.h"
+#include <cstdint>
+
+// Zobrist keys from the Polyglot Random64 table: 768 piece-square keys
+// (kind = 2 * type + (white ? 1 : 0), type order P N B R Q K), then four
+// castling keys, eight en passant file keys and the side-to-move key.
+// Board::hash() therefore equals the Polyglot key of the position.
+class Zobrist {
+public:
+  static uint64_t piece(char symbol, Pos p);
+  static uint64_t castling(int right); // 0 = K, 1 = Q, 2 = k, 3 = q
+  static uint64_t enPassant(int file);
+  static uint64_t whiteToMove();
+};
+
+#endif
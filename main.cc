@@ -1,8 +1,66 @@
 #include "GameController.h"
+#include "GameServer.h"
+#include <csignal>
 #include <iostream>
+#include <string>
+#include <thread>
 
-int main() {
-  GameController controller;
-  controller.run();
+namespace {
+  GameServer* activeServer = nullptr;
+
+  void stopServer(int) {
+    if (activeServer) activeServer->stop();
+  }
+
+  int parseCount(const char* value, int fallback) {
+    try {
+      return std::max(1, std::stoi(value));
+    } catch (...) {
+      return fallback;
+    }
+  }
+}
+
+// chess                         play on this terminal
+// chess --server unix:<path>    host games over a Unix-domain socket
+// chess --server tcp:<port>     ... or a TCP port on the loopback interface
+//   [--io-threads N] [--ai-threads N]
+int main(int argc, char* argv[]) {
+  std::string address;
+  int ioThreads = 2;
+  int aiThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--server" && i + 1 < argc) {
+      address = argv[++i];
+    } else if (arg == "--io-threads" && i + 1 < argc) {
+      ioThreads = parseCount(argv[++i], ioThreads);
+    } else if (arg == "--ai-threads" && i + 1 < argc) {
+      aiThreads = parseCount(argv[++i], aiThreads);
+    }
+  }
+
+  if (address.empty()) {
+    GameController controller;
+    controller.run();
+    return 0;
+  }
+
+  GameServer server(ioThreads, aiThreads);
+  if (!server.listen(address)) {
+    std::cerr << "Could not listen on " << address << " (use unix:<path> or tcp:<port>)\n";
+    return 1;
+  }
+
+  activeServer = &server;
+  std::signal(SIGINT, stopServer);
+  std::signal(SIGTERM, stopServer);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  std::cout << "Serving games on " << address << " (" << ioThreads << " I/O, "
+            << aiThreads << " AI threads)" << std::endl;
+  server.run();
+  activeServer = nullptr;
   return 0;
-} 
+}